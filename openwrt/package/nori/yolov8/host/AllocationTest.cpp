@@ -0,0 +1,245 @@
+// Runs the per-frame path of the pipeline on the VIPLite stub and checks that it doesn't allocate after warm-up:
+// ThreadSafeQueue hand-over, loadInput, submit, mapOutput, releaseOutputs and stats, two buffer slots in flight,
+// plus YoloV8Decoder and NmsEngine on a synthetic output when built with OpenCV.
+//
+//   AllocationTest <model.nb>
+
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "HostTest.hpp"
+#include "NeuralNetworkRuntime.hpp"
+#include "ThreadSafeQueue.hpp"
+#include "Dequantizer.hpp"
+
+#ifdef YOLOV8_HOST_OPENCV
+#include "YoloV8Decoder.hpp"
+#include "NmsEngine.hpp"
+#endif
+
+static std::atomic<bool> isCounting{false};
+static std::atomic<long> allocationCount{0};
+
+static void countAllocation()
+{
+    if (isCounting.load(std::memory_order_relaxed))
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// operator new of libstdc++ ends up in malloc, so this counts both, from every thread
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **pointer, size_t alignment, size_t size)
+{
+    countAllocation();
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer != nullptr ? 0 : ENOMEM;
+}
+
+}
+
+static const int WARM_UP_FRAME_COUNT = 16;
+static const int MEASURED_FRAME_COUNT = 256;
+
+struct InferenceResult
+{
+    NeuralNetworkRuntime::Ticket ticket = 0;
+    int bufferSlot = 0;
+    std::vector<float> scores;
+};
+
+#ifdef YOLOV8_HOST_OPENCV
+static const int CLASS_COUNT = 80;
+static const int ANCHOR_COUNT = 2100;
+
+// a few hundred anchors above the threshold in overlapping clusters, the same every frame
+static std::vector<float> createYoloV8Output()
+{
+    std::vector<float> output((4 + CLASS_COUNT) * ANCHOR_COUNT, 0.0f);
+
+    for (int a = 0; a < ANCHOR_COUNT; a++)
+    {
+        output[a] = 20.0f + (a % 30) * 20.0f + (a % 7);
+        output[ANCHOR_COUNT + a] = 20.0f + (a / 30 % 30) * 20.0f + (a % 5);
+        output[2 * ANCHOR_COUNT + a] = 40.0f;
+        output[3 * ANCHOR_COUNT + a] = 40.0f;
+        output[(4 + a % CLASS_COUNT) * ANCHOR_COUNT + a] = a % 5 == 0 ? 0.9f - (a % 11) * 0.05f : 0.1f;
+    }
+
+    return output;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: AllocationTest <model.nb>" << std::endl;
+        return 2;
+    }
+
+    NeuralNetworkRuntime::Config config;
+    config.modelFilePath = argv[1];
+    config.bufferSlotCount = 2;
+    config.isProfiling = true;
+    // the watchdog runs alongside, like in the pipeline
+    config.inferenceTimeoutMs = 1000;
+
+    NeuralNetworkRuntime nnRuntime(config);
+
+    ThreadSafeQueue<int> freeBufferSlotQueue(config.bufferSlotCount);
+    ThreadSafeQueue<InferenceResult> resultQueue(1);
+
+    for (int bufferSlot = 0; bufferSlot < nnRuntime.getBufferSlotCount(); bufferSlot++)
+    {
+        freeBufferSlotQueue.push(bufferSlot);
+    }
+
+    int frame = 0;
+    unsigned int inputSize = nnRuntime.getInputBufferSize(0);
+
+    // built once, a std::function holding a capture may allocate
+    NeuralNetworkRuntime::LoadingInputDataCallback onLoadingInputData =
+        [&frame, inputSize](int bufferIndex, void *buffer, NeuralNetworkRuntime::InputDataFormat elementDataFormat) {
+            memset(buffer, frame & 0xff, inputSize);
+        };
+
+    NeuralNetworkRuntime::Stats stats;
+    InferenceResult pendingResult;
+    InferenceResult finishedResult;
+
+#ifdef YOLOV8_HOST_OPENCV
+    std::vector<float> yoloV8Output = createYoloV8Output();
+    YoloV8Decoder::Output decoderOutput;
+    decoderOutput.data = yoloV8Output.data();
+    decoderOutput.depth = CV_32F;
+    decoderOutput.classCount = CLASS_COUNT;
+    decoderOutput.anchorCount = ANCHOR_COUNT;
+
+    YoloV8Decoder decoder;
+    NmsEngine nmsEngine;
+    NmsEngine::Config nmsConfig;
+    std::vector<int> classIds;
+    std::vector<float> confidences;
+    std::vector<cv::Rect2d> boxes;
+    std::vector<int> kept;
+#endif
+
+    auto collect = [&](InferenceResult &result) {
+        NeuralNetworkRuntime::OutputTensor outputTensor = nnRuntime.mapOutput(result.ticket, 0);
+        HOST_CHECK(outputTensor.dataFormat == NeuralNetworkRuntime::FORMAT_FP16);
+
+        result.scores.resize(outputTensor.elementCount);
+        Dequantizer::fp16ToFp32(outputTensor.data, result.scores.data(), outputTensor.elementCount, outputTensor.scale, outputTensor.zeroPoint);
+
+        nnRuntime.releaseOutputs(result.ticket);
+        freeBufferSlotQueue.push(result.bufferSlot);
+
+#ifdef YOLOV8_HOST_OPENCV
+        decoder.decode(decoderOutput, 0.25f, classIds, confidences, boxes);
+
+        nmsEngine.clear();
+        for (size_t i = 0; i < boxes.size(); i++)
+        {
+            nmsEngine.add(boxes[i], confidences[i], classIds[i]);
+        }
+        nmsEngine.run(nmsConfig, kept);
+#endif
+
+        nnRuntime.stats(stats);
+    };
+
+    for (frame = 0; frame < WARM_UP_FRAME_COUNT + MEASURED_FRAME_COUNT; frame++)
+    {
+        if (frame == WARM_UP_FRAME_COUNT)
+        {
+            isCounting.store(true);
+        }
+
+        int bufferSlot = 0;
+        freeBufferSlotQueue.pop(bufferSlot);
+
+        nnRuntime.loadInput(bufferSlot, onLoadingInputData);
+
+        // the previous frame is collected while this one is on the NPU
+        pendingResult.ticket = nnRuntime.submit(bufferSlot);
+        pendingResult.bufferSlot = bufferSlot;
+
+        if (!resultQueue.isEmpty())
+        {
+            resultQueue.pop(finishedResult);
+            collect(finishedResult);
+        }
+
+        resultQueue.push(pendingResult);
+    }
+
+    isCounting.store(false);
+
+    resultQueue.pop(finishedResult);
+    collect(finishedResult);
+
+    std::cout << "AllocationTest: " << allocationCount.load() << " allocations in " << MEASURED_FRAME_COUNT
+              << " frames after " << WARM_UP_FRAME_COUNT << " warm-up frames" << std::endl;
+#ifdef YOLOV8_HOST_OPENCV
+    std::cout << "AllocationTest: post-processing covered, " << kept.size() << " of " << boxes.size() << " boxes kept" << std::endl;
+#else
+    std::cout << "AllocationTest: built without OpenCV, YoloV8Decoder and NmsEngine not covered" << std::endl;
+#endif
+
+    // with VIP_STUB_DEVICE_COUNT=2 both devices run frames
+    unsigned long long inferenceCount = 0;
+    for (unsigned long long deviceInferenceCount : stats.deviceInferenceCounts)
+    {
+        HOST_CHECK(deviceInferenceCount > 0);
+        inferenceCount += deviceInferenceCount;
+    }
+    HOST_CHECK(inferenceCount == (unsigned long long)(WARM_UP_FRAME_COUNT + MEASURED_FRAME_COUNT));
+    HOST_CHECK(allocationCount.load() == 0);
+
+    std::cout << "AllocationTest: PASS" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Times the runtime side of running a batch of buffer slots on one device, one submit() per slot against one
+// submitBatch(), each followed by mapOutput and releaseOutputs of every slot. The VIPLite stub has no interrupts and
+// runs a vip_group as one trigger per network, so this measures what the runtime and driver calls cost per slot,
+// not the interrupts the group saves on the NPU. Set VIP_STUB_LATENCY_US to add a simulated inference time.
+//
+//   BatchBench <model.nb> [frames]
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <stdlib.h>
+
+#include "HostTest.hpp"
+#include "NeuralNetworkRuntime.hpp"
+
+static const int SLOT_COUNT = 4;
+
+static void collect(NeuralNetworkRuntime &nnRuntime, const std::vector<NeuralNetworkRuntime::Ticket> &tickets)
+{
+    for (NeuralNetworkRuntime::Ticket ticket : tickets)
+    {
+        NeuralNetworkRuntime::OutputTensor outputTensor = nnRuntime.mapOutput(ticket, 0);
+        HOST_CHECK(outputTensor.data != nullptr);
+        nnRuntime.releaseOutputs(ticket);
+    }
+}
+
+// mean microseconds per slot
+static double timeFrames(NeuralNetworkRuntime &nnRuntime, bool isBatch, int frameCount)
+{
+    std::vector<int> bufferSlots;
+    for (int i = 0; i < SLOT_COUNT; i++)
+    {
+        bufferSlots.push_back(i);
+    }
+    std::vector<NeuralNetworkRuntime::Ticket> tickets(SLOT_COUNT);
+
+    auto runFrame = [&]() {
+        if (isBatch)
+        {
+            tickets = nnRuntime.submitBatch(bufferSlots);
+        }
+        else
+        {
+            for (int i = 0; i < SLOT_COUNT; i++)
+            {
+                tickets[i] = nnRuntime.submit(bufferSlots[i]);
+            }
+        }
+        collect(nnRuntime, tickets);
+    };
+
+    // the first batch creates its group
+    for (int frame = 0; frame < 16; frame++)
+    {
+        runFrame();
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        runFrame();
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / frameCount / SLOT_COUNT;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: BatchBench <model.nb> [frames]" << std::endl;
+        return 2;
+    }
+    int frameCount = argc > 2 ? atoi(argv[2]) : 2000;
+    HOST_CHECK(frameCount > 0);
+
+    NeuralNetworkRuntime::Config config;
+    config.modelFilePath = argv[1];
+    config.bufferSlotCount = SLOT_COUNT;
+    config.isNetworkPerBufferSlot = true;
+    // a batch runs on one device, so do the single submits
+    config.maxDeviceCount = 1;
+
+    NeuralNetworkRuntime nnRuntime(config);
+
+    double singleUs = timeFrames(nnRuntime, false, frameCount);
+    double batchUs = timeFrames(nnRuntime, true, frameCount);
+
+    std::cout << SLOT_COUNT << " slots per frame, " << frameCount << " frames, per slot:" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "submit       " << std::setw(10) << singleUs << " us"
+              << std::endl;
+    std::cout << "submitBatch  " << std::setw(10) << batchUs << " us" << std::setw(8) << singleUs / batchUs << "x"
+              << std::endl;
+
+    nnRuntime.destroy();
+
+    return 0;
+}
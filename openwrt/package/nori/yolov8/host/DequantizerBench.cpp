@@ -0,0 +1,132 @@
+// Times every Dequantizer kernel against a plain per-element loop on one YOLOv8 640x640 output (84 x 8400),
+// and checks that both give the same values. Built for ARM it measures the NEON kernels, on the host the scalar
+// fallback. Needs nothing but Dequantizer.o, so it cross-compiles with the target CXX:
+//
+//   DequantizerBench [iterations]
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "HostTest.hpp"
+#include "Dequantizer.hpp"
+
+static const size_t ELEMENT_COUNT = 84 * 8400;
+
+template <typename T>
+static void referenceToFp32(const void *src, float *dst, size_t count, float scale, int zeroPoint)
+{
+    const T *in = static_cast<const T *>(src);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        dst[i] = ((float)in[i] - zeroPoint) * scale;
+    }
+}
+
+static float halfToFloat(uint16_t half)
+{
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    float value = exponent == 0 ? std::ldexp((float)mantissa, -24) : std::ldexp((float)(mantissa | 0x400), exponent - 25);
+    return (half & 0x8000) ? -value : value;
+}
+
+static void referenceFp16ToFp32(const void *src, float *dst, size_t count, float /* scale */, int /* zeroPoint */)
+{
+    const uint16_t *in = static_cast<const uint16_t *>(src);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        dst[i] = halfToFloat(in[i]);
+    }
+}
+
+// best of iterations, in microseconds
+static double timeKernel(Dequantizer::Function function, const void *src, float *dst, float scale, int zeroPoint,
+                         int iterations)
+{
+    double bestUs = 1e30;
+
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        function(src, dst, ELEMENT_COUNT, scale, zeroPoint);
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (elapsed.count() < bestUs)
+        {
+            bestUs = elapsed.count();
+        }
+    }
+
+    return bestUs;
+}
+
+static void runCase(const char *name, size_t elementSize, Dequantizer::Function kernel, Dequantizer::Function reference,
+                    float scale, int zeroPoint, int iterations)
+{
+    std::vector<uint8_t> src(ELEMENT_COUNT * elementSize);
+    std::vector<float> kernelDst(ELEMENT_COUNT);
+    std::vector<float> referenceDst(ELEMENT_COUNT);
+
+    for (size_t i = 0; i < src.size(); i++)
+    {
+        src[i] = (uint8_t)rand();
+    }
+    if (elementSize == 2 && reference == referenceFp16ToFp32)
+    {
+        // finite halves only, NaN never compares equal
+        for (size_t i = 0; i < ELEMENT_COUNT; i++)
+        {
+            src[i * 2 + 1] &= 0xbb;
+        }
+    }
+    if (elementSize == 4)
+    {
+        float *values = reinterpret_cast<float *>(src.data());
+        for (size_t i = 0; i < ELEMENT_COUNT; i++)
+        {
+            values[i] = (float)rand() / RAND_MAX;
+        }
+    }
+
+    double kernelUs = timeKernel(kernel, src.data(), kernelDst.data(), scale, zeroPoint, iterations);
+    double referenceUs = timeKernel(reference, src.data(), referenceDst.data(), scale, zeroPoint, iterations);
+
+    for (size_t i = 0; i < ELEMENT_COUNT; i++)
+    {
+        HOST_CHECK(std::fabs(kernelDst[i] - referenceDst[i]) <= 1e-5f * (1.0f + std::fabs(referenceDst[i])));
+    }
+
+    // bytes read and written per microsecond
+    double kernelMBps = (double)ELEMENT_COUNT * (elementSize + sizeof(float)) / kernelUs;
+
+    std::cout << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << kernelUs << " us" << std::setw(10) << referenceUs << " us"
+              << std::setw(8) << referenceUs / kernelUs << "x" << std::setw(10) << kernelMBps << " MB/s" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    HOST_CHECK(iterations > 0);
+
+    std::cout << ELEMENT_COUNT << " elements, best of " << iterations << ", "
+              << (Dequantizer::isNeonEnabled() ? "NEON" : "scalar") << " kernels" << std::endl;
+    std::cout << std::left << std::setw(8) << "format" << std::right << std::setw(13) << "kernel" << std::setw(13)
+              << "reference" << std::setw(9) << "speedup" << std::setw(15) << "kernel rate" << std::endl;
+
+    runCase("int8", 1, Dequantizer::int8ToFp32, referenceToFp32<int8_t>, 1.0f / 16, 0, iterations);
+    runCase("uint8", 1, Dequantizer::uint8ToFp32, referenceToFp32<uint8_t>, 0.0039f, 12, iterations);
+    runCase("int16", 2, Dequantizer::int16ToFp32, referenceToFp32<int16_t>, 1.0f / 256, 0, iterations);
+    runCase("fp16", 2, Dequantizer::fp16ToFp32, referenceFp16ToFp32, 1.0f, 0, iterations);
+    runCase("fp32", 4, Dequantizer::fp32ToFp32, referenceToFp32<float>, 1.0f, 0, iterations);
+
+    return 0;
+}
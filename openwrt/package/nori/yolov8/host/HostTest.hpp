@@ -0,0 +1,27 @@
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <stdlib.h>
+
+// Ends the test with exit code 1 and the failed condition.
+#define HOST_CHECK(condition)                                                                       \
+    do                                                                                              \
+    {                                                                                               \
+        if (!(condition))                                                                           \
+        {                                                                                           \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            exit(1);                                                                                \
+        }                                                                                           \
+    } while (0)
+
+// Copies a file byte for byte, e.g. a recording to corrupt or a model to take away.
+inline void copyFile(const std::string &srcFilePath, const std::string &dstFilePath)
+{
+    std::ifstream src(srcFilePath, std::ios::binary);
+    std::ofstream dst(dstFilePath, std::ios::binary);
+    HOST_CHECK(src && dst);
+    dst << src.rdbuf();
+}
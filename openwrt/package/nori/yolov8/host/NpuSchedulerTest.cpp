@@ -0,0 +1,187 @@
+// Runs two models through NpuScheduler on the VIPLite stub with simulated inference times:
+// with one request in flight the higher priority model goes first, with one per device both devices are used,
+// a priority above 255 is refused, and requests fail once the scheduler is stopped.
+//
+//   VIP_STUB_DEVICE_COUNT=2 VIP_STUB_LATENCY_US=5000 NpuSchedulerTest <model.nb>
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "HostTest.hpp"
+#include "NpuScheduler.hpp"
+
+static const int SLOT_COUNT = 4;
+
+struct Completions
+{
+    std::mutex mutex;
+    std::condition_variable condVar;
+    // model id of every completed request, in completion order
+    std::vector<int> modelIds;
+    int failedCount = 0;
+
+    NpuScheduler::CompletionCallback create(NpuScheduler &scheduler, NpuScheduler::ModelId modelId)
+    {
+        return [this, &scheduler, modelId](NeuralNetworkRuntime::Ticket ticket, std::exception_ptr error) {
+            if (error == nullptr)
+            {
+                scheduler.getRuntime(modelId).releaseOutputs(ticket);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            modelIds.push_back(modelId);
+            failedCount += error != nullptr;
+            condVar.notify_all();
+        };
+    }
+
+    void wait(int count)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condVar.wait(lock, [this, count]() { return (int)modelIds.size() >= count; });
+    }
+};
+
+static NpuScheduler::ModelConfig createModelConfig(const char *modelFilePath, const char *name, unsigned int priority)
+{
+    NpuScheduler::ModelConfig modelConfig;
+    modelConfig.name = name;
+    modelConfig.nnRuntimeConfig.modelFilePath = modelFilePath;
+    modelConfig.nnRuntimeConfig.bufferSlotCount = SLOT_COUNT;
+    modelConfig.priority = priority;
+    modelConfig.maxQueueDepth = SLOT_COUNT;
+    return modelConfig;
+}
+
+static void checkPriorityRange(const char *modelFilePath)
+{
+    NpuScheduler scheduler;
+
+    bool isRefused = false;
+    try
+    {
+        scheduler.addModel(createModelConfig(modelFilePath, "too high", 256));
+    }
+    catch (const std::invalid_argument &)
+    {
+        isRefused = true;
+    }
+    HOST_CHECK(isRefused);
+}
+
+// Queued before start(), one request at a time: all of the high priority model complete first.
+static void checkPriorityOrder(const char *modelFilePath)
+{
+    NpuScheduler::Config config;
+    config.maxInFlightCount = 1;
+    NpuScheduler scheduler(config);
+
+    NpuScheduler::ModelId lowModel = scheduler.addModel(createModelConfig(modelFilePath, "low", 1));
+    NpuScheduler::ModelId highModel = scheduler.addModel(createModelConfig(modelFilePath, "high", 200));
+
+    Completions completions;
+    for (int slot = 0; slot < SLOT_COUNT; slot++)
+    {
+        scheduler.request(lowModel, slot, completions.create(scheduler, lowModel));
+        scheduler.request(highModel, slot, completions.create(scheduler, highModel));
+    }
+
+    scheduler.start();
+    completions.wait(2 * SLOT_COUNT);
+    scheduler.stop();
+
+    HOST_CHECK(completions.failedCount == 0);
+    for (int i = 0; i < 2 * SLOT_COUNT; i++)
+    {
+        HOST_CHECK(completions.modelIds[i] == (i < SLOT_COUNT ? highModel : lowModel));
+    }
+}
+
+// One request per device: the requests of both models overlap on the two devices of the stub. One at a time, the
+// service times would add up to at most the elapsed time. Timing the overlap instead of the total holds up when the
+// test process is stalled, as both requests in flight are stretched alike.
+static void checkConcurrency(const char *modelFilePath)
+{
+    NpuScheduler scheduler;
+
+    NpuScheduler::ModelId modelA = scheduler.addModel(createModelConfig(modelFilePath, "a", 10));
+    NpuScheduler::ModelId modelB = scheduler.addModel(createModelConfig(modelFilePath, "b", 10));
+    HOST_CHECK(scheduler.getRuntime(modelA).getDeviceCount() == 2);
+
+    Completions completions;
+    for (int slot = 0; slot < SLOT_COUNT; slot++)
+    {
+        scheduler.request(modelA, slot, completions.create(scheduler, modelA));
+        scheduler.request(modelB, slot, completions.create(scheduler, modelB));
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    scheduler.start();
+    completions.wait(2 * SLOT_COUNT);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    scheduler.stop();
+
+    HOST_CHECK(completions.failedCount == 0);
+
+    double busyMs = 0;
+    for (auto &modelStats : scheduler.stats())
+    {
+        HOST_CHECK(modelStats.completedCount == SLOT_COUNT);
+        busyMs += modelStats.serviceTime.count * modelStats.serviceTime.mean / 1000.0;
+    }
+
+    std::cout << "NpuSchedulerTest: " << 2 * SLOT_COUNT << " requests in " << elapsed.count() << " ms, "
+              << busyMs << " ms of service time" << std::endl;
+
+    HOST_CHECK(busyMs > elapsed.count() * 1.5);
+}
+
+// A request after stop() fails at once, requests queued before a start() which never came fail on destruction.
+static void checkStopped(const char *modelFilePath)
+{
+    Completions completions;
+
+    {
+        NpuScheduler scheduler;
+        NpuScheduler::ModelId model = scheduler.addModel(createModelConfig(modelFilePath, "stopped", 10));
+
+        scheduler.start();
+        scheduler.stop();
+
+        scheduler.request(model, 0, completions.create(scheduler, model));
+        HOST_CHECK(completions.modelIds.size() == 1 && completions.failedCount == 1);
+    }
+
+    {
+        NpuScheduler scheduler;
+        NpuScheduler::ModelId model = scheduler.addModel(createModelConfig(modelFilePath, "never started", 10));
+
+        scheduler.request(model, 0, completions.create(scheduler, model));
+        HOST_CHECK(completions.modelIds.size() == 1);
+    }
+
+    HOST_CHECK(completions.modelIds.size() == 2 && completions.failedCount == 2);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: NpuSchedulerTest <model.nb>" << std::endl;
+        return 2;
+    }
+
+    checkPriorityRange(argv[1]);
+    checkPriorityOrder(argv[1]);
+    checkConcurrency(argv[1]);
+    checkStopped(argv[1]);
+
+    std::cout << "NpuSchedulerTest: PASS" << std::endl;
+
+    return 0;
+}
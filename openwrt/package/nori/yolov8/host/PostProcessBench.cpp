@@ -0,0 +1,339 @@
+// Times the frame kernels that replaced OpenCV calls against the OpenCV code they replaced, on synthetic frames:
+//   LetterboxQuantizer  vs cv::resize + cv::copyMakeBorder + cv::split into planes
+//   ResizeEngine        vs cv::resize, bilinear and area
+//   YoloV8Decoder       vs cv::transpose + convertTo + cv::minMaxLoc per anchor
+//   NmsEngine           vs cv::dnn::NMSBoxes on dense scenes of overlapping boxes
+// and checks that both sides find the same detections. Needs OpenCV with the dnn module, built for ARM it measures
+// the NEON paths:
+//
+//   PostProcessBench [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+
+#include "HostTest.hpp"
+#include "LetterboxQuantizer.hpp"
+#include "ResizeEngine.hpp"
+#include "YoloV8Decoder.hpp"
+#include "NmsEngine.hpp"
+
+static int iterations = 50;
+
+static std::mt19937 randomEngine(1234);
+
+// best of iterations, in microseconds
+template <typename Function>
+static double timeRun(Function function)
+{
+    double bestUs = 1e30;
+
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (elapsed.count() < bestUs)
+        {
+            bestUs = elapsed.count();
+        }
+    }
+
+    return bestUs;
+}
+
+static void printResult(const std::string &name, double kernelUs, double openCvUs)
+{
+    std::cout << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << kernelUs << " us" << std::setw(10) << openCvUs << " us"
+              << std::setw(8) << openCvUs / kernelUs << "x" << std::endl;
+}
+
+static cv::Mat createFrame(const cv::Size &size)
+{
+    cv::Mat frame(size, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(256));
+    // smooth, like a camera frame, so the resizes don't only see noise
+    cv::GaussianBlur(frame, frame, cv::Size(7, 7), 0);
+    return frame;
+}
+
+static void benchLetterbox(const cv::Size &srcSize, const cv::Size &dstSize)
+{
+    cv::Mat frame = createFrame(srcSize);
+
+    LetterboxQuantizer::Config config;
+    config.srcSize = srcSize;
+    config.dstSize = dstSize;
+    LetterboxQuantizer letterboxQuantizer(config);
+    std::vector<uint8_t> input(letterboxQuantizer.getOutputSize());
+
+    const cv::Rect &content = letterboxQuantizer.getGeometry().content;
+    cv::Mat resized;
+    cv::Mat letterboxed;
+    std::vector<uint8_t> openCvInput(input.size());
+
+    double kernelUs = timeRun([&]() { letterboxQuantizer.run(frame, input.data()); });
+    double openCvUs = timeRun([&]() {
+        cv::resize(frame, resized, content.size());
+        cv::copyMakeBorder(resized, letterboxed, content.y, dstSize.height - content.y - content.height, content.x,
+                           dstSize.width - content.x - content.width, cv::BORDER_CONSTANT, cv::Scalar(114, 114, 114));
+        cv::Mat planes[3];
+        for (int channel = 0; channel < 3; channel++)
+        {
+            planes[channel] = cv::Mat(dstSize, CV_8UC1, openCvInput.data() + channel * dstSize.area());
+        }
+        cv::split(letterboxed, planes);
+    });
+
+    // both are bilinear with 8-bit weights but round differently
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        HOST_CHECK(abs((int)input[i] - (int)openCvInput[i]) <= 2);
+    }
+
+    std::ostringstream name;
+    name << "letterbox " << srcSize << " -> " << dstSize;
+    printResult(name.str(), kernelUs, openCvUs);
+}
+
+static void benchResize(const cv::Size &srcSize, const cv::Size &dstSize, ResizeEngine::Interpolation interpolation)
+{
+    cv::Mat frame = createFrame(srcSize);
+
+    ResizeEngine::Config config;
+    config.srcSize = srcSize;
+    config.dstSize = dstSize;
+    config.interpolation = interpolation;
+    ResizeEngine resizeEngine(config);
+
+    bool isArea = interpolation == ResizeEngine::INTERPOLATION_AREA;
+    cv::Mat resized;
+    cv::Mat openCvResized;
+
+    double kernelUs = timeRun([&]() { resizeEngine.run(frame, resized); });
+    double openCvUs = timeRun([&]() {
+        cv::resize(frame, openCvResized, dstSize, 0, 0, isArea ? cv::INTER_AREA : cv::INTER_LINEAR);
+    });
+
+    cv::Mat difference;
+    cv::absdiff(resized, openCvResized, difference);
+    double maxDifference;
+    cv::minMaxLoc(difference.reshape(1), nullptr, &maxDifference);
+    HOST_CHECK(maxDifference <= 2);
+
+    std::ostringstream name;
+    name << (isArea ? "resize area " : "resize bilinear ") << srcSize << " -> " << dstSize;
+    printResult(name.str(), kernelUs, openCvUs);
+}
+
+// Rows cx, cy, w, h and then one row per class, channel-major like the NPU writes it.
+// Every anchor gets low scores, one in a hundred a score above the threshold. Quantised, the coordinates saturate,
+// only the scores matter here.
+template <typename T>
+static std::vector<T> createOutput(int classCount, int anchorCount, float scale, int zeroPoint)
+{
+    std::vector<T> output((4 + classCount) * anchorCount);
+    std::uniform_real_distribution<float> coordinate(0.0f, 320.0f);
+    std::uniform_real_distribution<float> lowScore(0.0f, 0.2f);
+    std::uniform_real_distribution<float> highScore(0.3f, 1.0f);
+    std::uniform_int_distribution<int> classId(0, classCount - 1);
+
+    auto quantize = [scale, zeroPoint](float value) {
+        float quantized = value / scale + zeroPoint;
+        quantized = std::min(quantized, (float)std::numeric_limits<T>::max());
+        quantized = std::max(quantized, (float)std::numeric_limits<T>::lowest());
+        return (T)quantized;
+    };
+
+    for (int anchor = 0; anchor < anchorCount; anchor++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            output[row * anchorCount + anchor] = quantize(coordinate(randomEngine));
+        }
+        for (int i = 0; i < classCount; i++)
+        {
+            output[(4 + i) * anchorCount + anchor] = quantize(lowScore(randomEngine));
+        }
+        if (anchor % 100 == 0)
+        {
+            output[(4 + classId(randomEngine)) * anchorCount + anchor] = quantize(highScore(randomEngine));
+        }
+    }
+
+    return output;
+}
+
+template <typename T>
+static void benchDecoder(const char *typeName, int depth, int classCount, int anchorCount, float scale, int zeroPoint)
+{
+    const float threshold = 0.25f;
+    std::vector<T> data = createOutput<T>(classCount, anchorCount, scale, zeroPoint);
+
+    YoloV8Decoder::Output output;
+    output.data = data.data();
+    output.depth = depth;
+    output.scale = scale;
+    output.zeroPoint = zeroPoint;
+    output.classCount = classCount;
+    output.anchorCount = anchorCount;
+
+    YoloV8Decoder decoder;
+    std::vector<int> classIds;
+    std::vector<float> confidences;
+    std::vector<cv::Rect2d> boxes;
+
+    cv::Mat transposed;
+    cv::Mat converted;
+    std::vector<int> openCvClassIds;
+    std::vector<float> openCvConfidences;
+    std::vector<cv::Rect2d> openCvBoxes;
+
+    double kernelUs = timeRun([&]() { decoder.decode(output, threshold, classIds, confidences, boxes); });
+    double openCvUs = timeRun([&]() {
+        cv::Mat mat(4 + classCount, anchorCount, depth, data.data());
+        cv::transpose(mat, transposed);
+        cv::Mat *values = &transposed;
+        if (depth != CV_32F)
+        {
+            transposed.convertTo(converted, CV_32F, scale, -zeroPoint * scale);
+            values = &converted;
+        }
+
+        openCvClassIds.clear();
+        openCvConfidences.clear();
+        openCvBoxes.clear();
+
+        for (int anchor = 0; anchor < anchorCount; anchor++)
+        {
+            const float *row = values->ptr<float>(anchor);
+            cv::Mat scores(1, classCount, CV_32FC1, (void *)(row + 4));
+            cv::Point classId;
+            double maxScore;
+            cv::minMaxLoc(scores, nullptr, &maxScore, nullptr, &classId);
+            if (maxScore > threshold)
+            {
+                openCvBoxes.push_back(cv::Rect2d(row[0] - 0.5f * row[2], row[1] - 0.5f * row[3], row[2], row[3]));
+                openCvConfidences.push_back(maxScore);
+                openCvClassIds.push_back(classId.x);
+            }
+        }
+    });
+
+    HOST_CHECK(classIds == openCvClassIds);
+    HOST_CHECK(boxes.size() == openCvBoxes.size());
+
+    std::ostringstream name;
+    name << "decode " << typeName << " " << 4 + classCount << " x " << anchorCount;
+    printResult(name.str(), kernelUs, openCvUs);
+}
+
+// objectCount objects, each seen by about candidateCount / objectCount boxes around it, as a YOLOv8 output is
+// before NMS in a crowded frame
+static void benchNms(int objectCount, int candidateCount)
+{
+    std::uniform_real_distribution<float> position(0.0f, 600.0f);
+    std::uniform_real_distribution<float> size(20.0f, 120.0f);
+    std::normal_distribution<float> jitter(0.0f, 4.0f);
+    std::uniform_real_distribution<float> score(0.25f, 1.0f);
+    std::uniform_int_distribution<int> objectIndex(0, objectCount - 1);
+
+    std::vector<cv::Rect2d> objects;
+    std::vector<int> objectClassIds;
+    for (int i = 0; i < objectCount; i++)
+    {
+        objects.push_back(
+            cv::Rect2d(position(randomEngine), position(randomEngine), size(randomEngine), size(randomEngine)));
+        objectClassIds.push_back(i % 80);
+    }
+
+    std::vector<cv::Rect2d> boxes;
+    std::vector<float> scores;
+    std::vector<int> classIds;
+    for (int i = 0; i < candidateCount; i++)
+    {
+        int object = objectIndex(randomEngine);
+        const cv::Rect2d &box = objects[object];
+        boxes.push_back(cv::Rect2d(box.x + jitter(randomEngine), box.y + jitter(randomEngine),
+                                   box.width + jitter(randomEngine), box.height + jitter(randomEngine)));
+        scores.push_back(score(randomEngine));
+        classIds.push_back(objectClassIds[object]);
+    }
+
+    NmsEngine nmsEngine;
+    NmsEngine::Config config;
+    // the same result as NMSBoxes
+    config.isClassAware = false;
+    config.maxDetections = 0;
+    std::vector<int> kept;
+    std::vector<int> openCvKept;
+
+    auto runNms = [&]() {
+        nmsEngine.clear();
+        for (int i = 0; i < candidateCount; i++)
+        {
+            nmsEngine.add(boxes[i], scores[i], classIds[i]);
+        }
+        nmsEngine.run(config, kept);
+    };
+
+    double kernelUs = timeRun(runNms);
+    double openCvUs = timeRun([&]() { cv::dnn::NMSBoxes(boxes, scores, 0.0f, config.iouThreshold, openCvKept); });
+
+    HOST_CHECK(kept == openCvKept);
+
+    config.isClassAware = true;
+    double classAwareUs = timeRun(runNms);
+
+    std::ostringstream name;
+    name << "nms " << candidateCount << " boxes, " << objectCount << " objects";
+    printResult(name.str(), kernelUs, openCvUs);
+    printResult(name.str() + ", class-aware", classAwareUs, openCvUs);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        iterations = atoi(argv[1]);
+    }
+    HOST_CHECK(iterations > 0);
+
+    // one thread like the A7, so OpenCV's parallel loops don't make the comparison about core count
+    cv::setNumThreads(1);
+
+    std::cout << "best of " << iterations << ", kernels " << (ResizeEngine::isNeonEnabled() ? "with" : "without")
+              << " NEON" << std::endl;
+    std::cout << std::left << std::setw(36) << "" << std::right << std::setw(13) << "kernel" << std::setw(13)
+              << "OpenCV" << std::setw(9) << "speedup" << std::endl;
+
+    benchLetterbox(cv::Size(640, 480), cv::Size(320, 320));
+    benchLetterbox(cv::Size(1280, 720), cv::Size(640, 640));
+
+    benchResize(cv::Size(640, 480), cv::Size(320, 240), ResizeEngine::INTERPOLATION_BILINEAR);
+    benchResize(cv::Size(640, 480), cv::Size(480, 272), ResizeEngine::INTERPOLATION_AREA);
+    benchResize(cv::Size(1280, 720), cv::Size(480, 272), ResizeEngine::INTERPOLATION_AREA);
+
+    benchDecoder<float>("fp32", CV_32F, 80, 2100, 1.0f, 0);
+    benchDecoder<int8_t>("int8", CV_8S, 80, 2100, 1.0f / 255, -128);
+    benchDecoder<int8_t>("int8", CV_8S, 80, 8400, 1.0f / 255, -128);
+
+    benchNms(10, 100);
+    benchNms(50, 1000);
+    benchNms(200, 4000);
+
+    return 0;
+}
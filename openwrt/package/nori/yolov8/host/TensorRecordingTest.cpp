@@ -0,0 +1,136 @@
+// Records inferences on two devices of the VIPLite stub and reads them back, then checks that the Reader refuses a
+// recording whose tensors don't fit in a frame, as the replay of the stub copies them out as they are.
+//
+//   VIP_STUB_DEVICE_COUNT=2 TensorRecordingTest <model.nb>
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "HostTest.hpp"
+#include "NeuralNetworkRuntime.hpp"
+#include "TensorRecording.hpp"
+
+static const int SLOT_COUNT = 4;
+static const int FRAME_COUNT = 32;
+
+// overwrites one field of the tensor table in place
+static void patchTensor(const std::string &filePath, int tensorIndex, size_t fieldOffset, uint32_t value)
+{
+    std::fstream file(filePath, std::ios::binary | std::ios::in | std::ios::out);
+    HOST_CHECK(file);
+    file.seekp(sizeof(TensorRecording::Header) + sizeof(TensorRecording::Tensor) * tensorIndex + fieldOffset);
+    file.write((const char *)&value, sizeof(value));
+}
+
+static bool isRefused(const std::string &filePath)
+{
+    try
+    {
+        TensorRecording::Reader reader(filePath);
+    }
+    catch (const std::runtime_error &)
+    {
+        return true;
+    }
+    return false;
+}
+
+static std::set<NeuralNetworkRuntime::Ticket> record(const char *modelFilePath, const std::string &recordFilePath)
+{
+    NeuralNetworkRuntime::Config config;
+    config.modelFilePath = modelFilePath;
+    config.bufferSlotCount = SLOT_COUNT;
+    config.recordFilePath = recordFilePath;
+    config.isRecordingInputs = true;
+
+    NeuralNetworkRuntime nnRuntime(config);
+    HOST_CHECK(nnRuntime.getDeviceCount() == 2);
+
+    std::set<NeuralNetworkRuntime::Ticket> tickets;
+    NeuralNetworkRuntime::Ticket slotTickets[SLOT_COUNT];
+
+    for (int frame = 0; frame < FRAME_COUNT; frame += SLOT_COUNT)
+    {
+        for (int slot = 0; slot < SLOT_COUNT; slot++)
+        {
+            slotTickets[slot] = nnRuntime.submit(slot);
+            tickets.insert(slotTickets[slot]);
+        }
+        for (int slot = 0; slot < SLOT_COUNT; slot++)
+        {
+            nnRuntime.mapOutput(slotTickets[slot], 0);
+            nnRuntime.releaseOutputs(slotTickets[slot]);
+        }
+    }
+
+    nnRuntime.destroy();
+
+    return tickets;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: TensorRecordingTest <model.nb>" << std::endl;
+        return 2;
+    }
+
+    std::string recordFilePath = "/tmp/TensorRecordingTest-" + std::to_string(getpid()) + ".rec";
+    std::string corruptFilePath = recordFilePath + ".corrupt";
+
+    std::set<NeuralNetworkRuntime::Ticket> tickets = record(argv[1], recordFilePath);
+
+    uint32_t inputCount = 0;
+    uint32_t frameSize = 0;
+    {
+        TensorRecording::Reader reader(recordFilePath);
+        HOST_CHECK(reader.getFrameCount() == FRAME_COUNT);
+
+        // both devices record, every frame once
+        std::set<NeuralNetworkRuntime::Ticket> recordedTickets;
+        for (uint64_t i = 0; i < reader.getFrameCount(); i++)
+        {
+            recordedTickets.insert(reader.getFrame(i).ticket);
+            HOST_CHECK(reader.getOutputData(i, 0) != nullptr);
+        }
+        HOST_CHECK(recordedTickets == tickets);
+
+        inputCount = reader.getHeader().inputCount;
+        frameSize = reader.getHeader().frameSize;
+        const TensorRecording::Tensor &output = reader.getOutput(0);
+        HOST_CHECK(output.offset + output.size <= frameSize);
+    }
+
+    // an output running past the end of the frame
+    copyFile(recordFilePath, corruptFilePath);
+    patchTensor(corruptFilePath, inputCount, offsetof(TensorRecording::Tensor, size), frameSize);
+    HOST_CHECK(isRefused(corruptFilePath));
+
+    // an output on top of the Frame header
+    copyFile(recordFilePath, corruptFilePath);
+    patchTensor(corruptFilePath, inputCount, offsetof(TensorRecording::Tensor, offset), 0);
+    HOST_CHECK(isRefused(corruptFilePath));
+
+    // offset + size wrapping around 32 bits
+    copyFile(recordFilePath, corruptFilePath);
+    patchTensor(corruptFilePath, inputCount, offsetof(TensorRecording::Tensor, size), 0xffffffc0);
+    HOST_CHECK(isRefused(corruptFilePath));
+
+    copyFile(recordFilePath, corruptFilePath);
+    HOST_CHECK(!isRefused(corruptFilePath));
+
+    unlink(recordFilePath.c_str());
+    unlink(corruptFilePath.c_str());
+
+    std::cout << "TensorRecordingTest: PASS" << std::endl;
+
+    return 0;
+}
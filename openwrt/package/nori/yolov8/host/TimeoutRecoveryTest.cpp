@@ -0,0 +1,125 @@
+// Cancels a hung inference (VIP_STUB_HANG_EVERY=3) and lets the rebuild of the network fail while the model file is
+// missing: submit() has to report the failure and retry on the next call instead of staying unprepared for good.
+// Also checks that closing a ThreadSafeQueue wakes a stage blocked on it, which is how a failed pipeline stage
+// stops the others.
+//
+//   VIP_STUB_HANG_EVERY=3 TimeoutRecoveryTest <model.nb>
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <atomic>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "HostTest.hpp"
+#include "NeuralNetworkRuntime.hpp"
+#include "VipStatusException.hpp"
+#include "ThreadSafeQueue.hpp"
+#include "QueueClosedException.hpp"
+
+static void runFrame(NeuralNetworkRuntime &nnRuntime)
+{
+    NeuralNetworkRuntime::Ticket ticket = nnRuntime.submit(0);
+    NeuralNetworkRuntime::OutputTensor outputTensor = nnRuntime.mapOutput(ticket, 0);
+    HOST_CHECK(outputTensor.data != nullptr);
+    nnRuntime.releaseOutputs(ticket);
+}
+
+static void checkQueueClose()
+{
+    ThreadSafeQueue<int> queue(1);
+    std::atomic<bool> isClosedSeen{false};
+
+    std::thread blockedStage([&queue, &isClosedSeen]() {
+        try
+        {
+            queue.pop();
+        }
+        catch (const QueueClosedException &)
+        {
+            isClosedSeen.store(true);
+        }
+    });
+
+    usleep(10000);
+    queue.close();
+    blockedStage.join();
+
+    HOST_CHECK(isClosedSeen.load());
+    HOST_CHECK(!queue.push(1));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: TimeoutRecoveryTest <model.nb>" << std::endl;
+        return 2;
+    }
+
+    // a copy, so it can be taken away while the network is rebuilt
+    std::string modelFilePath = "/tmp/TimeoutRecoveryTest-" + std::to_string(getpid()) + ".nb";
+    std::string movedModelFilePath = modelFilePath + ".moved";
+    copyFile(argv[1], modelFilePath);
+
+    NeuralNetworkRuntime::Config config;
+    config.modelFilePath = modelFilePath;
+    config.bufferSlotCount = 1;
+    config.inferenceTimeoutMs = 100;
+
+    NeuralNetworkRuntime nnRuntime(config);
+
+    runFrame(nnRuntime);
+    runFrame(nnRuntime);
+
+    // the third inference hangs until the watchdog cancels it
+    NeuralNetworkRuntime::Ticket hungTicket = nnRuntime.submit(0);
+    bool isTimedOut = false;
+    try
+    {
+        nnRuntime.mapOutput(hungTicket, 0);
+    }
+    catch (const InferenceTimeoutException &e)
+    {
+        isTimedOut = e.getTicket() == hungTicket;
+    }
+    HOST_CHECK(isTimedOut);
+    nnRuntime.releaseOutputs(hungTicket);
+
+    HOST_CHECK(rename(modelFilePath.c_str(), movedModelFilePath.c_str()) == 0);
+
+    // the rebuild fails with the status of the driver, and is tried again by every submit
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        bool isRebuildFailed = false;
+        try
+        {
+            nnRuntime.submit(0);
+        }
+        catch (const VipStatusException &e)
+        {
+            isRebuildFailed = true;
+        }
+        HOST_CHECK(isRebuildFailed);
+    }
+
+    HOST_CHECK(rename(movedModelFilePath.c_str(), modelFilePath.c_str()) == 0);
+
+    runFrame(nnRuntime);
+    runFrame(nnRuntime);
+
+    NeuralNetworkRuntime::Stats stats = nnRuntime.stats();
+    HOST_CHECK(stats.timeoutCount == 1);
+    HOST_CHECK(stats.recoveryTime.count == 1);
+
+    nnRuntime.destroy();
+    unlink(modelFilePath.c_str());
+
+    checkQueueClose();
+
+    std::cout << "TimeoutRecoveryTest: PASS" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "ClockScaler.hpp"
+
+ClockScaler::ClockScaler(const Config &config) : config(config)
+{
+    if (this->config.minScalePercent < 1)
+    {
+        this->config.minScalePercent = 1;
+    }
+    if (this->config.minScalePercent > 100)
+    {
+        this->config.minScalePercent = 100;
+    }
+    if (this->config.windowSize < 1)
+    {
+        this->config.windowSize = 1;
+    }
+}
+
+unsigned int ClockScaler::getTargetScalePercent(uint32_t timeUs) const
+{
+    // the time at full clock is timeUs * scalePercent / 100
+    double targetTimeUs = config.targetTimeUs * (double)config.targetLoad;
+    unsigned int targetScalePercent = (unsigned int)(timeUs * (double)scalePercent / targetTimeUs + 0.999);
+
+    if (targetScalePercent < config.minScalePercent)
+    {
+        return config.minScalePercent;
+    }
+    if (targetScalePercent > 100)
+    {
+        return 100;
+    }
+    return targetScalePercent;
+}
+
+unsigned int ClockScaler::update(uint32_t timeUs)
+{
+    if (config.targetTimeUs == 0)
+    {
+        return 0;
+    }
+
+    if (timeUs > windowMaxTimeUs)
+    {
+        windowMaxTimeUs = timeUs;
+    }
+
+    // a single late inference raises the clock without waiting for the window to fill
+    bool isOverloaded = timeUs > config.targetTimeUs * config.upperLoad;
+
+    if (!isOverloaded && ++windowCount < config.windowSize)
+    {
+        return 0;
+    }
+
+    uint32_t maxTimeUs = windowMaxTimeUs;
+    windowCount = 0;
+    windowMaxTimeUs = 0;
+
+    unsigned int newScalePercent = scalePercent;
+
+    if (isOverloaded)
+    {
+        lowLoadWindowCount = 0;
+        newScalePercent = getTargetScalePercent(maxTimeUs);
+    }
+    else if (maxTimeUs < config.targetTimeUs * config.lowerLoad)
+    {
+        if (++lowLoadWindowCount >= config.scaleDownWindowCount)
+        {
+            lowLoadWindowCount = 0;
+            newScalePercent = getTargetScalePercent(maxTimeUs);
+        }
+    }
+    else
+    {
+        lowLoadWindowCount = 0;
+    }
+
+    if (newScalePercent == scalePercent)
+    {
+        return 0;
+    }
+
+    scalePercent = newScalePercent;
+    return scalePercent;
+}
+
+unsigned int ClockScaler::getScalePercent() const
+{
+    return scalePercent;
+}
+
+void ClockScaler::reset()
+{
+    scalePercent = 100;
+    windowCount = 0;
+    windowMaxTimeUs = 0;
+    lowLoadWindowCount = 0;
+}
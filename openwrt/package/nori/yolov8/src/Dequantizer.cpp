@@ -0,0 +1,161 @@
+#include "Dequantizer.hpp"
+
+#include <cstring>
+
+#include <stdint.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DEQUANTIZER_NEON 1
+// vcvt_f32_f16 needs the half precision extension, e.g. -mfpu=neon-vfpv4
+#if defined(__ARM_FP) && (__ARM_FP & 2)
+#define DEQUANTIZER_NEON_FP16 1
+#endif
+#endif
+
+namespace
+{
+    typedef union
+    {
+        unsigned int u;
+        float f;
+    } _fp32_t;
+
+    inline float fp16_to_fp32(const unsigned short in)
+    {
+        const _fp32_t magic = {(254 - 15) << 23};
+        const _fp32_t infnan = {(127 + 16) << 23};
+        _fp32_t o;
+        // Non-sign bits
+        o.u = (in & 0x7fff) << 13;
+        o.f *= magic.f;
+        if (o.f >= infnan.f)
+        {
+            o.u |= 255 << 23;
+        }
+        // Sign bit
+        o.u |= (in & 0x8000) << 16;
+        return o.f;
+    }
+
+    template <typename T>
+    inline void scalarToFp32(const T *src, float *dst, size_t count, float scale, int zeroPoint)
+    {
+        const float bias = -(float)zeroPoint * scale;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            dst[i] = (float)src[i] * scale + bias;
+        }
+    }
+
+#ifdef DEQUANTIZER_NEON
+    inline void storeScaled(float *dst, int32x4_t value, float32x4_t bias, float scale)
+    {
+        vst1q_f32(dst, vmlaq_n_f32(bias, vcvtq_f32_s32(value), scale));
+    }
+#endif
+}
+
+void Dequantizer::int8ToFp32(const void *src, float *dst, size_t count, float scale, int zeroPoint)
+{
+    const int8_t *in = static_cast<const int8_t *>(src);
+    size_t i = 0;
+
+#ifdef DEQUANTIZER_NEON
+    const float32x4_t bias = vdupq_n_f32(-(float)zeroPoint * scale);
+
+    for (; i + 16 <= count; i += 16)
+    {
+        int8x16_t value = vld1q_s8(in + i);
+        int16x8_t low = vmovl_s8(vget_low_s8(value));
+        int16x8_t high = vmovl_s8(vget_high_s8(value));
+
+        storeScaled(dst + i, vmovl_s16(vget_low_s16(low)), bias, scale);
+        storeScaled(dst + i + 4, vmovl_s16(vget_high_s16(low)), bias, scale);
+        storeScaled(dst + i + 8, vmovl_s16(vget_low_s16(high)), bias, scale);
+        storeScaled(dst + i + 12, vmovl_s16(vget_high_s16(high)), bias, scale);
+    }
+#endif
+
+    scalarToFp32(in + i, dst + i, count - i, scale, zeroPoint);
+}
+
+void Dequantizer::uint8ToFp32(const void *src, float *dst, size_t count, float scale, int zeroPoint)
+{
+    const uint8_t *in = static_cast<const uint8_t *>(src);
+    size_t i = 0;
+
+#ifdef DEQUANTIZER_NEON
+    const float32x4_t bias = vdupq_n_f32(-(float)zeroPoint * scale);
+
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16_t value = vld1q_u8(in + i);
+        // zero-extended uint8 always fits into int16
+        int16x8_t low = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(value)));
+        int16x8_t high = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(value)));
+
+        storeScaled(dst + i, vmovl_s16(vget_low_s16(low)), bias, scale);
+        storeScaled(dst + i + 4, vmovl_s16(vget_high_s16(low)), bias, scale);
+        storeScaled(dst + i + 8, vmovl_s16(vget_low_s16(high)), bias, scale);
+        storeScaled(dst + i + 12, vmovl_s16(vget_high_s16(high)), bias, scale);
+    }
+#endif
+
+    scalarToFp32(in + i, dst + i, count - i, scale, zeroPoint);
+}
+
+void Dequantizer::int16ToFp32(const void *src, float *dst, size_t count, float scale, int zeroPoint)
+{
+    const int16_t *in = static_cast<const int16_t *>(src);
+    size_t i = 0;
+
+#ifdef DEQUANTIZER_NEON
+    const float32x4_t bias = vdupq_n_f32(-(float)zeroPoint * scale);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x8_t value = vld1q_s16(in + i);
+
+        storeScaled(dst + i, vmovl_s16(vget_low_s16(value)), bias, scale);
+        storeScaled(dst + i + 4, vmovl_s16(vget_high_s16(value)), bias, scale);
+    }
+#endif
+
+    scalarToFp32(in + i, dst + i, count - i, scale, zeroPoint);
+}
+
+void Dequantizer::fp16ToFp32(const void *src, float *dst, size_t count, float /* scale */, int /* zeroPoint */)
+{
+    const unsigned short *in = static_cast<const unsigned short *>(src);
+    size_t i = 0;
+
+#ifdef DEQUANTIZER_NEON_FP16
+    for (; i + 4 <= count; i += 4)
+    {
+        float16x4_t value = vreinterpret_f16_u16(vld1_u16(in + i));
+
+        vst1q_f32(dst + i, vcvt_f32_f16(value));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        dst[i] = fp16_to_fp32(in[i]);
+    }
+}
+
+void Dequantizer::fp32ToFp32(const void *src, float *dst, size_t count, float /* scale */, int /* zeroPoint */)
+{
+    std::memcpy(dst, src, count * sizeof(float));
+}
+
+bool Dequantizer::isNeonEnabled()
+{
+#ifdef DEQUANTIZER_NEON
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,94 @@
+#include "LatencyHistogram.hpp"
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+int LatencyHistogram::getBucketIndex(uint32_t value)
+{
+    if (value < SUB_BUCKET_COUNT)
+    {
+        return value;
+    }
+
+    int msb = 31 - __builtin_clz(value);
+    int shift = msb - SUB_BUCKET_BITS;
+
+    return (shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) & (SUB_BUCKET_COUNT - 1));
+}
+
+uint32_t LatencyHistogram::getBucketUpperBound(int bucketIndex)
+{
+    if (bucketIndex < SUB_BUCKET_COUNT)
+    {
+        return bucketIndex;
+    }
+
+    int shift = bucketIndex / SUB_BUCKET_COUNT - 1;
+    uint64_t lowerBound = (uint64_t)(SUB_BUCKET_COUNT + bucketIndex % SUB_BUCKET_COUNT) << shift;
+
+    return (uint32_t)(lowerBound + ((uint64_t)1 << shift) - 1);
+}
+
+void LatencyHistogram::record(uint32_t value)
+{
+    buckets[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint32_t currentMax = max.load(std::memory_order_relaxed);
+    while (value > currentMax && !max.compare_exchange_weak(currentMax, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+LatencyHistogram::Percentiles LatencyHistogram::getPercentiles() const
+{
+    Percentiles percentiles;
+
+    unsigned long long bucketCounts[BUCKET_COUNT];
+    unsigned long long total = 0;
+
+    for (int i = 0; i < BUCKET_COUNT; i++)
+    {
+        bucketCounts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += bucketCounts[i];
+    }
+
+    if (total == 0)
+    {
+        return percentiles;
+    }
+
+    percentiles.count = total;
+    percentiles.max = max.load(std::memory_order_relaxed);
+    percentiles.mean = (double)sum.load(std::memory_order_relaxed) / total;
+
+    const double ranks[3] = {0.50, 0.95, 0.99};
+    unsigned int *values[3] = {&percentiles.p50, &percentiles.p95, &percentiles.p99};
+
+    unsigned long long cumulative = 0;
+    int rankIndex = 0;
+    for (int i = 0; i < BUCKET_COUNT && rankIndex < 3; i++)
+    {
+        cumulative += bucketCounts[i];
+        while (rankIndex < 3 && cumulative >= ranks[rankIndex] * total)
+        {
+            uint32_t upperBound = getBucketUpperBound(i);
+            *values[rankIndex] = upperBound < percentiles.max ? upperBound : percentiles.max;
+            rankIndex++;
+        }
+    }
+
+    return percentiles;
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < BUCKET_COUNT; i++)
+    {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,530 @@
+#include "LetterboxQuantizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LETTERBOX_QUANTIZER_NEON 1
+// vcvt_f16_f32 needs the half precision extension, e.g. -mfpu=neon-vfpv4
+#if defined(__ARM_FP) && (__ARM_FP & 2)
+#define LETTERBOX_QUANTIZER_NEON_FP16 1
+#endif
+#endif
+
+namespace
+{
+    typedef union
+    {
+        unsigned int u;
+        float f;
+    } _fp32_t;
+
+    // round to nearest even
+    inline unsigned short fp32_to_fp16(float in)
+    {
+        const _fp32_t f16max = {(127 + 16) << 23};
+        const _fp32_t f32infty = {255 << 23};
+        const _fp32_t denormMagic = {((127 - 15) + (23 - 10) + 1) << 23};
+        _fp32_t f;
+        f.f = in;
+
+        unsigned int sign = f.u & 0x80000000u;
+        f.u ^= sign;
+
+        unsigned short o;
+        if (f.u >= f16max.u)
+        {
+            o = f.u > f32infty.u ? 0x7e00 : 0x7c00;
+        }
+        else if (f.u < (113u << 23))
+        {
+            f.f += denormMagic.f;
+            o = f.u - denormMagic.u;
+        }
+        else
+        {
+            unsigned int mantissaOdd = (f.u >> 13) & 1;
+            f.u += ((unsigned int)(15 - 127) << 23) + 0xfff;
+            f.u += mantissaOdd;
+            o = f.u >> 13;
+        }
+
+        return o | (sign >> 16);
+    }
+
+    inline uint32_t clampToBits(int32_t value, int32_t min, int32_t max)
+    {
+        return (uint32_t)std::min(std::max(value, min), max);
+    }
+
+    size_t getElementSize(NeuralNetworkRuntime::InputDataFormat dataFormat)
+    {
+        switch (dataFormat)
+        {
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT8:
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_INT8:
+                return 1;
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_FP16:
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT16:
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_INT16:
+                return 2;
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_FP32:
+                return 4;
+            default:
+                throw std::invalid_argument("Unsupported input data format: " + std::to_string(dataFormat));
+        }
+    }
+
+#ifdef LETTERBOX_QUANTIZER_NEON
+    // round(p * scale) + zeroPoint of 16 pixels, p * scale is never negative
+    inline void quantize(uint8x16_t pixels, float scale, int32x4_t zeroPoint, int32x4_t out[4])
+    {
+        const float32x4_t half = vdupq_n_f32(0.5f);
+        uint16x8_t low = vmovl_u8(vget_low_u8(pixels));
+        uint16x8_t high = vmovl_u8(vget_high_u8(pixels));
+
+        out[0] = vaddq_s32(vcvtq_s32_f32(vmlaq_n_f32(half, vcvtq_f32_u32(vmovl_u16(vget_low_u16(low))), scale)), zeroPoint);
+        out[1] = vaddq_s32(vcvtq_s32_f32(vmlaq_n_f32(half, vcvtq_f32_u32(vmovl_u16(vget_high_u16(low))), scale)), zeroPoint);
+        out[2] = vaddq_s32(vcvtq_s32_f32(vmlaq_n_f32(half, vcvtq_f32_u32(vmovl_u16(vget_low_u16(high))), scale)), zeroPoint);
+        out[3] = vaddq_s32(vcvtq_s32_f32(vmlaq_n_f32(half, vcvtq_f32_u32(vmovl_u16(vget_high_u16(high))), scale)), zeroPoint);
+    }
+
+    inline void scale(uint8x16_t pixels, float scale, float32x4_t zeroPoint, float32x4_t out[4])
+    {
+        uint16x8_t low = vmovl_u8(vget_low_u8(pixels));
+        uint16x8_t high = vmovl_u8(vget_high_u8(pixels));
+
+        out[0] = vmlaq_n_f32(zeroPoint, vcvtq_f32_u32(vmovl_u16(vget_low_u16(low))), scale);
+        out[1] = vmlaq_n_f32(zeroPoint, vcvtq_f32_u32(vmovl_u16(vget_high_u16(low))), scale);
+        out[2] = vmlaq_n_f32(zeroPoint, vcvtq_f32_u32(vmovl_u16(vget_low_u16(high))), scale);
+        out[3] = vmlaq_n_f32(zeroPoint, vcvtq_f32_u32(vmovl_u16(vget_high_u16(high))), scale);
+    }
+#endif
+}
+
+LetterboxQuantizer::Geometry LetterboxQuantizer::getGeometry(const cv::Size &srcSize, const cv::Size &dstSize)
+{
+    Geometry geometry;
+
+    if (srcSize == dstSize)
+    {
+        geometry.scaleRatio = 1.0f;
+        geometry.content = cv::Rect(0, 0, dstSize.width, dstSize.height);
+        return geometry;
+    }
+
+    float scaleRatio = std::min((float)dstSize.height / srcSize.height, (float)dstSize.width / srcSize.width);
+    scaleRatio = std::min(scaleRatio, 1.0f);
+
+    int unpaddedHeight = static_cast<int>(round(srcSize.height * scaleRatio));
+    int unpaddedWidth = static_cast<int>(round(srcSize.width * scaleRatio));
+
+    float deltaHeight = (dstSize.height - unpaddedHeight) * 0.5f;
+    float deltaWidth = (dstSize.width - unpaddedWidth) * 0.5f;
+    int top = static_cast<int>(round(deltaHeight - 0.1));
+    int left = static_cast<int>(round(deltaWidth - 0.1));
+
+    geometry.scaleRatio = scaleRatio;
+    geometry.content = cv::Rect(left, top, unpaddedWidth, unpaddedHeight);
+
+    return geometry;
+}
+
+LetterboxQuantizer::Config LetterboxQuantizer::makeConfig(const cv::Size &srcSize, const NeuralNetworkRuntime::OutputTensor &inputTensor)
+{
+    if ((inputTensor.numOfDims != 3 && inputTensor.numOfDims != 4) || inputTensor.sizes[2] != 3 ||
+        (inputTensor.numOfDims == 4 && inputTensor.sizes[3] != 1))
+    {
+        throw std::invalid_argument("Input isn't a single planar 3 channel image");
+    }
+
+    Config config;
+    config.srcSize = srcSize;
+    config.dstSize = cv::Size(inputTensor.sizes[0], inputTensor.sizes[1]);
+    config.dataFormat = inputTensor.dataFormat;
+
+    bool isFloat = inputTensor.dataFormat == NeuralNetworkRuntime::InputDataFormat::FORMAT_FP32 ||
+                   inputTensor.dataFormat == NeuralNetworkRuntime::InputDataFormat::FORMAT_FP16;
+
+    bool isInt8 = inputTensor.dataFormat == NeuralNetworkRuntime::InputDataFormat::FORMAT_INT8;
+
+    bool isDynamicFixedPoint = inputTensor.quantFormat == NeuralNetworkRuntime::QuantFormat::QUANT_DYNAMIC_FIXED_POINT;
+
+    if (isInt8 && (inputTensor.quantFormat == NeuralNetworkRuntime::QuantFormat::QUANT_NONE || isDynamicFixedPoint))
+    {
+        if (isDynamicFixedPoint)
+        {
+            // p * 2^fixedPointPos / 255 can't be the pixel - 128 int8 models were always fed with
+            std::cerr << "LetterboxQuantizer: dynamic fixed point int8 input, fed with pixel - 128 as before, "
+                         "pass a LetterboxQuantizer::Config for another mapping" << std::endl;
+        }
+
+        // int8 input without quantisation gets pixel - 128, as it always did
+        config.scale = config.pixelScale;
+        config.zeroPoint = -128;
+    }
+    else if (inputTensor.quantFormat != NeuralNetworkRuntime::QuantFormat::QUANT_NONE || isFloat)
+    {
+        config.scale = inputTensor.scale;
+        config.zeroPoint = inputTensor.zeroPoint;
+    }
+    else
+    {
+        // other integer inputs without quantisation take the pixel values as they are
+        config.scale = config.pixelScale;
+        config.zeroPoint = 0;
+    }
+
+    return config;
+}
+
+LetterboxQuantizer::LetterboxQuantizer(const cv::Size &srcSize, const NeuralNetworkRuntime::OutputTensor &inputTensor)
+    : LetterboxQuantizer(makeConfig(srcSize, inputTensor))
+{
+}
+
+ResizeEngine::Config LetterboxQuantizer::makeResizeConfig(const Config &config, const Geometry &geometry)
+{
+    if (config.srcSize.width <= 0 || config.srcSize.height <= 0 || config.dstSize.width <= 0 || config.dstSize.height <= 0)
+    {
+        throw std::invalid_argument("Invalid letterbox size");
+    }
+
+    ResizeEngine::Config resizeConfig;
+    resizeConfig.srcSize = config.srcSize;
+    resizeConfig.dstSize = geometry.content.size();
+    resizeConfig.interpolation = config.interpolation;
+    resizeConfig.channels = 3;
+
+    return resizeConfig;
+}
+
+LetterboxQuantizer::LetterboxQuantizer(const Config &config)
+    : config(config),
+      geometry(getGeometry(config.srcSize, config.dstSize)),
+      elementSize(::getElementSize(config.dataFormat)),
+      isResizing(geometry.content.size() != config.srcSize),
+      resizeEngine(makeResizeConfig(config, geometry))
+{
+    if (!(config.scale > 0.0f) || !(config.pixelScale > 0.0f))
+    {
+        throw std::invalid_argument("Invalid input scale");
+    }
+
+    createLut();
+
+    resizedRow.resize(3 * geometry.content.width);
+    pixelRow.resize(3 * geometry.content.width);
+}
+
+void LetterboxQuantizer::createLut()
+{
+    quantScale = config.pixelScale / config.scale;
+
+    for (int p = 0; p < 256; p++)
+    {
+        // the same operations as the NEON path, so both round alike
+        float value = p * quantScale;
+        int32_t q = (int32_t)(value + 0.5f) + config.zeroPoint;
+        _fp32_t real;
+        real.f = value + (float)config.zeroPoint;
+
+        switch (config.dataFormat)
+        {
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT8:
+                lut[p] = clampToBits(q, 0, UINT8_MAX);
+                break;
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_INT8:
+                lut[p] = (uint8_t)clampToBits(q, INT8_MIN, INT8_MAX);
+                break;
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT16:
+                lut[p] = clampToBits(q, 0, UINT16_MAX);
+                break;
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_INT16:
+                lut[p] = (uint16_t)clampToBits(q, INT16_MIN, INT16_MAX);
+                break;
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_FP16:
+                lut[p] = fp32_to_fp16(real.f);
+                break;
+            default:
+                lut[p] = real.u;
+                break;
+        }
+    }
+}
+
+const LetterboxQuantizer::Config &LetterboxQuantizer::getConfig() const
+{
+    return config;
+}
+
+const LetterboxQuantizer::Geometry &LetterboxQuantizer::getGeometry() const
+{
+    return geometry;
+}
+
+size_t LetterboxQuantizer::getOutputSize() const
+{
+    return (size_t)config.dstSize.width * config.dstSize.height * 3 * elementSize;
+}
+
+void LetterboxQuantizer::splitRow(const uint8_t *src)
+{
+    int width = geometry.content.width;
+
+    uint8_t *blue = pixelRow.data() + (config.isRgb ? 2 : 0) * width;
+    uint8_t *green = pixelRow.data() + width;
+    uint8_t *red = pixelRow.data() + (config.isRgb ? 0 : 2) * width;
+    int x = 0;
+
+#ifdef LETTERBOX_QUANTIZER_NEON
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16x3_t bgr = vld3q_u8(src + 3 * x);
+
+        vst1q_u8(blue + x, bgr.val[0]);
+        vst1q_u8(green + x, bgr.val[1]);
+        vst1q_u8(red + x, bgr.val[2]);
+    }
+#endif
+
+    for (; x < width; x++)
+    {
+        blue[x] = src[3 * x];
+        green[x] = src[3 * x + 1];
+        red[x] = src[3 * x + 2];
+    }
+}
+
+void LetterboxQuantizer::quantizeRow(const uint8_t *src, uint8_t *dst, int count) const
+{
+    int i = 0;
+
+#ifdef LETTERBOX_QUANTIZER_NEON
+    const int32x4_t zeroPoint = vdupq_n_s32(config.zeroPoint);
+    int32x4_t q[4];
+
+    switch (config.dataFormat)
+    {
+        case NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT8:
+            for (; i + 16 <= count; i += 16)
+            {
+                quantize(vld1q_u8(src + i), quantScale, zeroPoint, q);
+                int16x8_t low = vcombine_s16(vqmovn_s32(q[0]), vqmovn_s32(q[1]));
+                int16x8_t high = vcombine_s16(vqmovn_s32(q[2]), vqmovn_s32(q[3]));
+                vst1q_u8(dst + i, vcombine_u8(vqmovun_s16(low), vqmovun_s16(high)));
+            }
+            break;
+        case NeuralNetworkRuntime::InputDataFormat::FORMAT_INT8:
+            for (; i + 16 <= count; i += 16)
+            {
+                quantize(vld1q_u8(src + i), quantScale, zeroPoint, q);
+                int16x8_t low = vcombine_s16(vqmovn_s32(q[0]), vqmovn_s32(q[1]));
+                int16x8_t high = vcombine_s16(vqmovn_s32(q[2]), vqmovn_s32(q[3]));
+                vst1q_s8((int8_t *)dst + i, vcombine_s8(vqmovn_s16(low), vqmovn_s16(high)));
+            }
+            break;
+        case NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT16:
+            for (; i + 16 <= count; i += 16)
+            {
+                quantize(vld1q_u8(src + i), quantScale, zeroPoint, q);
+                vst1q_u16((uint16_t *)dst + i, vcombine_u16(vqmovun_s32(q[0]), vqmovun_s32(q[1])));
+                vst1q_u16((uint16_t *)dst + i + 8, vcombine_u16(vqmovun_s32(q[2]), vqmovun_s32(q[3])));
+            }
+            break;
+        case NeuralNetworkRuntime::InputDataFormat::FORMAT_INT16:
+            for (; i + 16 <= count; i += 16)
+            {
+                quantize(vld1q_u8(src + i), quantScale, zeroPoint, q);
+                vst1q_s16((int16_t *)dst + i, vcombine_s16(vqmovn_s32(q[0]), vqmovn_s32(q[1])));
+                vst1q_s16((int16_t *)dst + i + 8, vcombine_s16(vqmovn_s32(q[2]), vqmovn_s32(q[3])));
+            }
+            break;
+        case NeuralNetworkRuntime::InputDataFormat::FORMAT_FP32:
+        {
+            const float32x4_t realZeroPoint = vdupq_n_f32(config.zeroPoint);
+            float32x4_t real[4];
+
+            for (; i + 16 <= count; i += 16)
+            {
+                scale(vld1q_u8(src + i), quantScale, realZeroPoint, real);
+                for (int j = 0; j < 4; j++)
+                {
+                    vst1q_f32((float *)dst + i + 4 * j, real[j]);
+                }
+            }
+            break;
+        }
+#ifdef LETTERBOX_QUANTIZER_NEON_FP16
+        case NeuralNetworkRuntime::InputDataFormat::FORMAT_FP16:
+        {
+            const float32x4_t realZeroPoint = vdupq_n_f32(config.zeroPoint);
+            float32x4_t real[4];
+
+            for (; i + 16 <= count; i += 16)
+            {
+                scale(vld1q_u8(src + i), quantScale, realZeroPoint, real);
+                for (int j = 0; j < 4; j++)
+                {
+                    vst1_u16((uint16_t *)dst + i + 4 * j, vreinterpret_u16_f16(vcvt_f16_f32(real[j])));
+                }
+            }
+            break;
+        }
+#endif
+        default:
+            break;
+    }
+#endif
+
+    switch (elementSize)
+    {
+        case 1:
+            for (; i < count; i++)
+            {
+                dst[i] = (uint8_t)lut[src[i]];
+            }
+            break;
+        case 2:
+            for (; i < count; i++)
+            {
+                ((uint16_t *)dst)[i] = (uint16_t)lut[src[i]];
+            }
+            break;
+        default:
+            for (; i < count; i++)
+            {
+                ((uint32_t *)dst)[i] = lut[src[i]];
+            }
+            break;
+    }
+}
+
+void LetterboxQuantizer::splitQuantizeRow(const uint8_t *src, uint8_t *planes[3])
+{
+    int width = geometry.content.width;
+
+#ifdef LETTERBOX_QUANTIZER_NEON
+    splitRow(src);
+
+    for (int plane = 0; plane < 3; plane++)
+    {
+        quantizeRow(pixelRow.data() + plane * width, planes[plane], width);
+    }
+#else
+    // the lookup straight from the interleaved row, the planar copy only pays off for the vector quantisation
+    uint8_t *blue = planes[config.isRgb ? 2 : 0];
+    uint8_t *green = planes[1];
+    uint8_t *red = planes[config.isRgb ? 0 : 2];
+
+    switch (elementSize)
+    {
+        case 1:
+            for (int x = 0; x < width; x++, src += 3)
+            {
+                blue[x] = (uint8_t)lut[src[0]];
+                green[x] = (uint8_t)lut[src[1]];
+                red[x] = (uint8_t)lut[src[2]];
+            }
+            break;
+        case 2:
+            for (int x = 0; x < width; x++, src += 3)
+            {
+                ((uint16_t *)blue)[x] = (uint16_t)lut[src[0]];
+                ((uint16_t *)green)[x] = (uint16_t)lut[src[1]];
+                ((uint16_t *)red)[x] = (uint16_t)lut[src[2]];
+            }
+            break;
+        default:
+            for (int x = 0; x < width; x++, src += 3)
+            {
+                ((uint32_t *)blue)[x] = lut[src[0]];
+                ((uint32_t *)green)[x] = lut[src[1]];
+                ((uint32_t *)red)[x] = lut[src[2]];
+            }
+            break;
+    }
+#endif
+}
+
+void LetterboxQuantizer::fillRow(uint8_t *dst, int count) const
+{
+    uint32_t padding = lut[config.padValue];
+
+    switch (elementSize)
+    {
+        case 1:
+            memset(dst, (uint8_t)padding, count);
+            break;
+        case 2:
+            std::fill_n((uint16_t *)dst, count, (uint16_t)padding);
+            break;
+        default:
+            std::fill_n((uint32_t *)dst, count, padding);
+            break;
+    }
+}
+
+void LetterboxQuantizer::run(const cv::Mat &frame, void *output)
+{
+    if (frame.type() != CV_8UC3 || frame.size() != config.srcSize)
+    {
+        throw std::invalid_argument("Frame doesn't match the letterbox, must be 8 bits per pixel, 3 channels and " +
+                                    std::to_string(config.srcSize.width) + "x" + std::to_string(config.srcSize.height));
+    }
+
+    uint8_t *out = static_cast<uint8_t *>(output);
+    int width = config.dstSize.width;
+    size_t rowSize = width * elementSize;
+    size_t planeSize = rowSize * config.dstSize.height;
+    const cv::Rect &content = geometry.content;
+
+    resizeEngine.startFrame();
+
+    for (int y = 0; y < config.dstSize.height; y++)
+    {
+        int row = y - content.y;
+
+        if (row < 0 || row >= content.height)
+        {
+            for (int plane = 0; plane < 3; plane++)
+            {
+                fillRow(out + plane * planeSize + y * rowSize, width);
+            }
+            continue;
+        }
+
+        const uint8_t *src = frame.ptr<uint8_t>(row);
+        if (isResizing)
+        {
+            resizeEngine.resizeRow(frame, row, resizedRow.data());
+            src = resizedRow.data();
+        }
+
+        uint8_t *planes[3];
+        for (int plane = 0; plane < 3; plane++)
+        {
+            uint8_t *dst = out + plane * planeSize + y * rowSize;
+
+            fillRow(dst, content.x);
+            fillRow(dst + (content.x + content.width) * elementSize, width - content.x - content.width);
+            planes[plane] = dst + content.x * elementSize;
+        }
+
+        splitQuantizeRow(src, planes);
+    }
+}
+
+bool LetterboxQuantizer::isNeonEnabled()
+{
+#ifdef LETTERBOX_QUANTIZER_NEON
+    return true;
+#else
+    return false;
+#endif
+}
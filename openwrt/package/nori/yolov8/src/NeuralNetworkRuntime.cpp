@@ -7,6 +7,12 @@
 #include <algorithm>
 #include <utility>
 #include <cstring>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 #include <stdint.h>
 
@@ -16,10 +22,19 @@
 #include <memory.h>
 #include <stdlib.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "vip_lite.h"
 
 #include "NullPointerException.hpp"
 #include "VipStatusException.hpp"
+#include "Dequantizer.hpp"
+#include "NpuContext.hpp"
+#include "ClockScaler.hpp"
+#include "TensorRecording.hpp"
 
 #include <sstream>
 #include <iomanip>
@@ -35,21 +50,144 @@ private:
         TYPE_OUT
     };
 
-    typedef union
+    struct BufferSlot
+    {
+        std::vector<vip_buffer> inputBuffers;
+        std::vector<vip_uint32_t> inputMemoryTypes;
+        std::vector<vip_buffer> outputBuffers;
+        // CPU address of each output while it is mapped, nullptr otherwise
+        std::vector<void *> mappedOutputs;
+        // ticket of the last submitted inference whose outputs are not collected yet, 0 if none
+        NeuralNetworkRuntime::Ticket ticket = 0;
+        bool isInFlight = false;
+        // index into networkInstances and the device of the last submit
+        int networkInstance = 0;
+        int device = 0;
+        // get_perf_count() when the inference was triggered
+        uint64_t submitTime = 0;
+        // the inference of ticket was cancelled by the watchdog, its outputs are garbage
+        bool isTimedOut = false;
+    };
+
+    // One VIP device, it runs one inference or one batch of inferences at a time
+    struct Device
     {
-        unsigned int u;
-        float f;
-    } _fp32_t;
+        unsigned int coreCount = 1;
+        // in submit order, the group runs them if there are several
+        std::vector<int> inFlightSlots;
+        vip_group inFlightGroup = nullptr;
+        // a thread is blocked in vip_wait_network for this device
+        bool isWaiting = false;
+        // the watchdog cancelled the in-flight inference
+        bool isCancelled = false;
+        bool isFirstInferenceAfterResume = false;
+        // submit to complete time of all inferences in ns, the load for DISPATCH_LEAST_LOADED
+        uint64_t busyTime = 0;
+        unsigned long long inferenceCount = 0;
+    };
+
+    // A command buffer and the buffers currently patched into it
+    struct NetworkInstance
+    {
+        vip_network network = nullptr;
+        // a vip_weak_dup_network of the network of its device, which it needs to outlive
+        bool isDuplicate = false;
+        std::vector<vip_buffer> boundInputBuffers;
+        std::vector<vip_buffer> boundOutputBuffers;
+    };
 
     NeuralNetworkRuntime::Config config;
 
     vip_network network = nullptr;
 
-    std::vector<vip_buffer_create_params_t> inputBufferParameters;
-    std::vector<vip_buffer> inputBuffers;
+    // The network of every device, [0] is network. Each is created from the binary and pinned to its device
+    // before it is prepared, vip_set_network has no effect afterwards.
+    std::vector<vip_network> deviceNetworks;
 
+    std::vector<vip_buffer_create_params_t> inputBufferParameters;
     std::vector<vip_buffer_create_params_t> outputBufferParameters;
-    std::vector<vip_buffer> outputBuffers;
+    // converter of each output selected from its data format, nullptr if unsupported
+    std::vector<Dequantizer::Function> outputDequantizers;
+
+    std::vector<BufferSlot> bufferSlots;
+
+    // The first instance of every device is the network of the device, the others are weak duplicates sharing its
+    // coefficients. Grouped by device, see getNetworkInstanceIndex.
+    std::vector<NetworkInstance> networkInstances;
+
+    std::vector<Device> devices;
+    // DISPATCH_ROUND_ROBIN
+    int nextDevice = 0;
+
+    // vip_group of the network instances of bufferSlots in that order, trigger runs any prefix of them
+    struct BatchGroup
+    {
+        int device;
+        std::vector<int> bufferSlots;
+        vip_group group;
+    };
+    std::vector<BatchGroup> batchGroups;
+
+    bool isUsingSharedMemoryPool = false;
+
+    // network binary while the network is created, unused with MODEL_LOAD_FROM_FILE
+    void *networkBinary = nullptr;
+    unsigned int networkBinarySize = 0;
+
+    std::shared_future<void> preparedFuture;
+    std::atomic<bool> isPrepared{false};
+
+    uint64_t createStartTime = 0;
+
+    // all in microseconds except npuCycles
+    LatencyHistogram npuInferenceTime;
+    LatencyHistogram npuCycles;
+    LatencyHistogram submitToCompleteTime;
+    LatencyHistogram driverOverheadTime;
+    LatencyHistogram inputFlushTime;
+    LatencyHistogram outputMapTime;
+    LatencyHistogram recoveryTime;
+    std::atomic<unsigned long long> timeoutCount{0};
+
+    // only used by the thread in vip_wait_network, while the NPU is idle
+    ClockScaler clockScaler;
+    std::atomic<unsigned int> clockScalePercent{100};
+    std::atomic<unsigned long long> clockScaleChangeCount{0};
+
+    LatencyHistogram resumeTime;
+    LatencyHistogram firstInferenceAfterResumeTime;
+    std::atomic<unsigned long long> powerOffCount{0};
+
+    NeuralNetworkRuntime::Ticket lastTicket = 0;
+
+    // submit/wait and the output mapping may be called from different threads
+    mutable std::mutex mutex;
+    std::condition_variable waitingCondVar;
+
+    // cancels the in-flight inference once it runs past config.inferenceTimeoutMs
+    std::thread watchdogThread;
+    std::condition_variable watchdogCondVar;
+    bool isWatchdogStopping = false;
+    // a cancelled network is replaced by the next submit, once no device is running
+    bool isRebuildPending = false;
+
+    // powers the NPU off once nothing was submitted for config.idlePowerOffMs, submit() powers it on again
+    std::thread idleThread;
+    std::condition_variable idleCondVar;
+    bool isIdleStopping = false;
+    std::atomic<bool> isPoweredOff{false};
+    // get_perf_count() of the last completed inference or power on
+    uint64_t lastActiveTime = 0;
+
+    // NpuContext::acquire succeeded, the network itself may be gone after a failed rebuild
+    bool hasNpuContext = false;
+
+    // config.recordFilePath, written by the threads in vip_wait_network under recordingMutex, not under mutex
+    std::mutex recordingMutex;
+    std::unique_ptr<TensorRecording::Writer> recordingWriter;
+    // the tensors of the frame being written, sized once by createRecordingWriter()
+    std::vector<const void *> recordedInputs;
+    std::vector<const void *> recordedOutputs;
 
     long frameCount = 0;
     
@@ -78,7 +216,7 @@ private:
         outFile.close();
     }
 
-    void queryBufferParameter(int index, vip_buffer_create_params_t &bufferCreateParams, BufferType type)
+    void queryBufferParameter(vip_network queriedNetwork, int index, vip_buffer_create_params_t &bufferCreateParams, BufferType type)
     {
         vip_status_e (*vipQueryBufferProp)(vip_network, vip_uint32_t, vip_enum, void *);
 
@@ -97,29 +235,29 @@ private:
 
         memset(&bufferCreateParams, 0, sizeof(vip_buffer_create_params_t));
 
-        vip_status_e status = vipQueryBufferProp(network, index, VIP_BUFFER_PROP_DATA_FORMAT, &bufferCreateParams.data_format);
+        vip_status_e status = vipQueryBufferProp(queriedNetwork, index, VIP_BUFFER_PROP_DATA_FORMAT, &bufferCreateParams.data_format);
         CHECK_VIP_STATUS(status);
 
-        status = vipQueryBufferProp(network, index, VIP_BUFFER_PROP_NUM_OF_DIMENSION, &bufferCreateParams.num_of_dims);
+        status = vipQueryBufferProp(queriedNetwork, index, VIP_BUFFER_PROP_NUM_OF_DIMENSION, &bufferCreateParams.num_of_dims);
         CHECK_VIP_STATUS(status);
 
-        status = vipQueryBufferProp(network, index, VIP_BUFFER_PROP_SIZES_OF_DIMENSION, &bufferCreateParams.sizes);
+        status = vipQueryBufferProp(queriedNetwork, index, VIP_BUFFER_PROP_SIZES_OF_DIMENSION, &bufferCreateParams.sizes);
         CHECK_VIP_STATUS(status);
 
-        status = vipQueryBufferProp(network, index, VIP_BUFFER_PROP_QUANT_FORMAT, &bufferCreateParams.quant_format);
+        status = vipQueryBufferProp(queriedNetwork, index, VIP_BUFFER_PROP_QUANT_FORMAT, &bufferCreateParams.quant_format);
         CHECK_VIP_STATUS(status);
 
         switch (bufferCreateParams.quant_format)
         {
         case VIP_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT:
-            status = vipQueryBufferProp(network, index, VIP_BUFFER_PROP_FIXED_POINT_POS, &bufferCreateParams.quant_data.dfp.fixed_point_pos);
+            status = vipQueryBufferProp(queriedNetwork, index, VIP_BUFFER_PROP_FIXED_POINT_POS, &bufferCreateParams.quant_data.dfp.fixed_point_pos);
             CHECK_VIP_STATUS(status);
             break;
         case VIP_BUFFER_QUANTIZE_TF_ASYMM:
-            status = vipQueryBufferProp(network, index, VIP_BUFFER_PROP_TF_SCALE, &bufferCreateParams.quant_data.affine.scale);
+            status = vipQueryBufferProp(queriedNetwork, index, VIP_BUFFER_PROP_TF_SCALE, &bufferCreateParams.quant_data.affine.scale);
             CHECK_VIP_STATUS(status);
 
-            status = vipQueryBufferProp(network, index, VIP_BUFFER_PROP_TF_ZERO_POINT, &bufferCreateParams.quant_data.affine.zeroPoint);
+            status = vipQueryBufferProp(queriedNetwork, index, VIP_BUFFER_PROP_TF_ZERO_POINT, &bufferCreateParams.quant_data.affine.zeroPoint);
             CHECK_VIP_STATUS(status);
             break;
         case VIP_BUFFER_QUANTIZE_NONE:
@@ -134,457 +272,2100 @@ private:
         vip_status_e status = vip_query_network(network, VIP_NETWORK_PROP_INPUT_COUNT, &inputCount);
         CHECK_VIP_STATUS(status);
 
-        for (int i = 0; i < inputCount; i++)
+        for (vip_uint32_t i = 0; i < inputCount; i++)
         {
             vip_buffer_create_params_t bufferCreateParams;
-            queryBufferParameter(i, bufferCreateParams, BufferType::TYPE_IN);
+            queryBufferParameter(network, i, bufferCreateParams, BufferType::TYPE_IN);
 
             inputBufferParameters.push_back(bufferCreateParams);
-
-            vip_buffer inputBuffer;
-            status = vip_create_buffer(&bufferCreateParams, sizeof(bufferCreateParams), &inputBuffer);
-            CHECK_VIP_STATUS(status);
-
-            inputBuffers.push_back(inputBuffer);
         }
 
         vip_uint32_t outputCount;
         status = vip_query_network(network, VIP_NETWORK_PROP_OUTPUT_COUNT, &outputCount);
         CHECK_VIP_STATUS(status);
 
-        for (int i = 0; i < outputCount; i++)
+        for (vip_uint32_t i = 0; i < outputCount; i++)
         {
             vip_buffer_create_params_t bufferCreateParams;
-            queryBufferParameter(i, bufferCreateParams, BufferType::TYPE_OUT);
+            queryBufferParameter(network, i, bufferCreateParams, BufferType::TYPE_OUT);
 
             outputBufferParameters.push_back(bufferCreateParams);
-
-            vip_buffer outputBuffer;
-            status = vip_create_buffer(&bufferCreateParams, sizeof(bufferCreateParams), &outputBuffer);
-            CHECK_VIP_STATUS(status);
-
-            outputBuffers.push_back(outputBuffer);
-        }
-    }
-
-    inline NeuralNetworkRuntime::InputDataFormat mapToInputDataFormat(vip_enum dataFormat)
-    {
-        NeuralNetworkRuntime::InputDataFormat format;
-
-        switch (dataFormat)
-        {
-            case VIP_BUFFER_FORMAT_FP32:
-                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_FP32;
-                break;
-            case VIP_BUFFER_FORMAT_FP16:
-                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_FP16;
-                break;
-            case VIP_BUFFER_FORMAT_UINT8:
-                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT8;
-                break;
-            case VIP_BUFFER_FORMAT_INT8:
-                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_INT8;
-                break;
-            case VIP_BUFFER_FORMAT_UINT16:
-                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT16;
-                break;
-            case VIP_BUFFER_FORMAT_INT16:
-                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_INT16;
-                break;
-            default:
-                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_UNKNOWN;
-                break;
+            outputDequantizers.push_back(selectDequantizer(bufferCreateParams.data_format));
         }
 
-        return format;
-    }
+        bufferSlots.resize(config.bufferSlotCount);
 
-    void loadInputData(const NeuralNetworkRuntime::LoadingInputDataCallback& onLoadingInputData)
-    {
-        for(int i = 0; i < inputBuffers.size(); i++)
+        for (auto &bufferSlot : bufferSlots)
         {
-            void *buffer = vip_map_buffer(inputBuffers[i]);
-
-            vip_buffer_create_params_t &bufferCreateParams = inputBufferParameters[i];
+            for (auto &bufferCreateParams : inputBufferParameters)
+            {
+                vip_buffer inputBuffer;
+                status = vip_create_buffer(&bufferCreateParams, sizeof(bufferCreateParams), &inputBuffer);
+                CHECK_VIP_STATUS(status);
 
-            NeuralNetworkRuntime::InputDataFormat elementDataFormat = mapToInputDataFormat(bufferCreateParams.data_format);
+                bufferSlot.inputBuffers.push_back(inputBuffer);
+                bufferSlot.inputMemoryTypes.push_back(VIP_BUFFER_MEMORY_TYPE_DEFAULT);
+            }
 
-            onLoadingInputData(i, buffer, elementDataFormat);
+            for (auto &bufferCreateParams : outputBufferParameters)
+            {
+                vip_buffer outputBuffer;
+                status = vip_create_buffer(&bufferCreateParams, sizeof(bufferCreateParams), &outputBuffer);
+                CHECK_VIP_STATUS(status);
 
-            vip_unmap_buffer(inputBuffers[i]);
+                bufferSlot.outputBuffers.push_back(outputBuffer);
+                bufferSlot.mappedOutputs.push_back(nullptr);
+            }
         }
     }
 
-    vip_uint32_t getFormatBytes(const vip_enum type)
+    vip_uint32_t queryBuffersSize(vip_network queriedNetwork, BufferType type)
     {
-        switch (type)
+        vip_uint32_t count;
+        vip_status_e status = vip_query_network(queriedNetwork, type == BufferType::TYPE_IN ? VIP_NETWORK_PROP_INPUT_COUNT : VIP_NETWORK_PROP_OUTPUT_COUNT, &count);
+        CHECK_VIP_STATUS(status);
+
+        vip_uint32_t size = 0;
+        for (vip_uint32_t i = 0; i < count; i++)
         {
-        case VIP_BUFFER_FORMAT_INT8:
-        case VIP_BUFFER_FORMAT_UINT8:
-            return 1;
-        case VIP_BUFFER_FORMAT_INT16:
-        case VIP_BUFFER_FORMAT_UINT16:
-        case VIP_BUFFER_FORMAT_FP16:
-        case VIP_BUFFER_FORMAT_BFP16:
-            return 2;
-        case VIP_BUFFER_FORMAT_FP32:
-        case VIP_BUFFER_FORMAT_INT32:
-        case VIP_BUFFER_FORMAT_UINT32:
-            return 4;
-        case VIP_BUFFER_FORMAT_FP64:
-        case VIP_BUFFER_FORMAT_INT64:
-        case VIP_BUFFER_FORMAT_UINT64:
-            return 8;
+            vip_buffer_create_params_t bufferCreateParams;
+            queryBufferParameter(queriedNetwork, i, bufferCreateParams, type);
 
-        default:
-            return 0;
+            size += getBufferSize(bufferCreateParams);
         }
+
+        return size;
     }
 
-    static float int8_to_fp32(signed char val, signed char fixedPointPos)
+    // Creates the network once in a probe vip_init to find out how much memory it really needs.
+    unsigned int measureMemSize()
     {
-        float result = 0.0f;
+        vip_status_e status = vip_init(config.autoMemProbeSize);
+        CHECK_VIP_STATUS(status);
+
+        vip_uint32_t deviceCount = getUsedDeviceCount(queryDeviceCount());
+        vip_network probeNetwork = nullptr;
+        vip_uint32_t memoryPoolSize = 0;
+        vip_uint32_t inputsSize = 0;
+        vip_uint32_t outputsSize = 0;
 
-        if (fixedPointPos > 0)
+        try
         {
-            result = (float)val * (1.0f / ((float)(1 << fixedPointPos)));
+            status = createNetwork(&probeNetwork);
+            CHECK_VIP_STATUS(status);
+
+            status = vip_query_network(probeNetwork, VIP_NETWORK_PROP_MEMORY_POOL_SIZE, &memoryPoolSize);
+            CHECK_VIP_STATUS(status);
+
+            inputsSize = queryBuffersSize(probeNetwork, BufferType::TYPE_IN);
+            outputsSize = queryBuffersSize(probeNetwork, BufferType::TYPE_OUT);
         }
-        else
+        catch (...)
         {
-            result = (float)val * ((float)(1 << -fixedPointPos));
+            if (probeNetwork != nullptr)
+            {
+                vip_destroy_network(probeNetwork);
+            }
+            vip_destroy();
+            throw;
         }
 
-        return result;
+        vip_destroy_network(probeNetwork);
+        vip_destroy();
+
+        unsigned int buffersSize = (inputsSize + outputsSize) * config.bufferSlotCount;
+        // every device has its own network
+        unsigned int memSize = (memoryPoolSize + networkBinarySize) * deviceCount + buffersSize + config.memSizeMargin;
+        // page granularity
+        memSize = (memSize + 4095) & ~4095u;
+
+        std::cout << "NeuralNetworkRuntime auto memSize: " << memSize << " bytes" << std::endl;
+        std::cout << "  memory pool: " << memoryPoolSize << " x " << deviceCount << " devices" << std::endl;
+        std::cout << "  network binary: " << networkBinarySize << " x " << deviceCount << " devices" << std::endl;
+        std::cout << "  inputs: " << inputsSize << " x " << config.bufferSlotCount << " slots" << std::endl;
+        std::cout << "  outputs: " << outputsSize << " x " << config.bufferSlotCount << " slots" << std::endl;
+        std::cout << "  margin: " << config.memSizeMargin << std::endl;
+
+        return memSize;
     }
 
-    static float int16_to_fp32(vip_int16_t val, signed char fixedPointPos)
+    // Must happen before vip_prepare_network, which would allocate a private pool otherwise.
+    // Only the network of device 0 uses it, the other devices run at the same time.
+    void attachSharedMemoryPool()
     {
-        float result = 0.0f;
+        vip_uint32_t memoryPoolSize = 0;
+        vip_status_e status = vip_query_network(network, VIP_NETWORK_PROP_MEMORY_POOL_SIZE, &memoryPoolSize);
+        CHECK_VIP_STATUS(status);
 
-        if (fixedPointPos > 0)
+        if (memoryPoolSize == 0)
         {
-            result = (float)val * (1.0f / ((float)(1 << fixedPointPos)));
-        }
-        else
-        {
-            result = (float)val * ((float)(1 << -fixedPointPos));
+            return;
         }
 
-        return result;
-    }
+        vip_buffer memoryPool = NpuContext::acquireMemoryPool(memoryPoolSize);
+        isUsingSharedMemoryPool = true;
 
-    static vip_float_t affine_to_fp32(vip_int32_t val, vip_int32_t zeroPoint, vip_float_t scale)
-    {
-        vip_float_t result = 0.0f;
-        result = ((vip_float_t)val - zeroPoint) * scale;
-        return result;
+        status = vip_set_network(network, VIP_NETWORK_PROP_SET_MEMORY_POOL, memoryPool);
+        CHECK_VIP_STATUS(status);
     }
 
-    static vip_float_t uint8_to_fp32(vip_uint8_t val, vip_int32_t zeroPoint, vip_float_t scale)
+    BufferSlot &getBufferSlot(int bufferSlot)
     {
-        vip_float_t result = 0.0f;
-        result = (val - (vip_uint8_t)zeroPoint) * scale;
-        return result;
+        if (bufferSlot < 0 || bufferSlot >= (int)bufferSlots.size())
+        {
+            throw std::out_of_range("Invalid buffer slot: " + std::to_string(bufferSlot));
+        }
+
+        return bufferSlots[bufferSlot];
     }
 
-    static float fp16_to_fp32(const short in)
+    const vip_buffer_create_params_t &getInputBufferParameter(int inputIndex) const
     {
-        const _fp32_t magic = {(254 - 15) << 23};
-        const _fp32_t infnan = {(127 + 16) << 23};
-        _fp32_t o;
-        // Non-sign bits
-        o.u = (in & 0x7fff) << 13;
-        o.f *= magic.f;
-        if (o.f >= infnan.f)
+        if (inputIndex < 0 || inputIndex >= (int)inputBufferParameters.size())
         {
-            o.u |= 255 << 23;
+            throw std::out_of_range("Invalid input index: " + std::to_string(inputIndex));
         }
-        // Sign bit
-        o.u |= (in & 0x8000) << 16;
-        return o.f;
+
+        return inputBufferParameters[inputIndex];
     }
 
-    vip_status_e integer_convert(const void *src, void *dest, vip_enum src_dtype, vip_enum dst_dtype)
+    void replaceInputBuffer(int bufferSlotIndex, int inputIndex, vip_buffer inputBuffer, vip_uint32_t memoryType)
     {
-        vip_status_e status = VIP_SUCCESS;
+        BufferSlot &bufferSlot = bufferSlots[bufferSlotIndex];
 
-        unsigned char all_zeros[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-        unsigned char all_ones[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
-        vip_uint32_t src_sz = getFormatBytes(src_dtype);
-        vip_uint32_t dest_sz = getFormatBytes(dst_dtype);
-        unsigned char *buffer = all_zeros;
-        if (((vip_int8_t *)src)[src_sz - 1] & 0x80)
+        // a new buffer may reuse the handle value of the destroyed one, so forget the binding explicitly
+        for (auto &networkInstance : networkInstances)
         {
-            buffer = all_ones;
+            if (networkInstance.boundInputBuffers[inputIndex] == bufferSlot.inputBuffers[inputIndex])
+            {
+                networkInstance.boundInputBuffers[inputIndex] = nullptr;
+            }
         }
-        memcpy(buffer, src, src_sz);
-        memcpy(dest, buffer, dest_sz);
 
-        return status;
-    }
+        vip_destroy_buffer(bufferSlot.inputBuffers[inputIndex]);
 
+        bufferSlot.inputBuffers[inputIndex] = inputBuffer;
+        bufferSlot.inputMemoryTypes[inputIndex] = memoryType;
+    }
 
-    unsigned int get_file_size(const char *name)
+    void checkExternalInputMemory(int bufferSlotIndex, int inputIndex, unsigned int size)
     {
-        FILE *fp = fopen(name, "rb");
-        unsigned int size = 0;
+        BufferSlot &bufferSlot = getBufferSlot(bufferSlotIndex);
 
-        if (fp != NULL)
+        if (bufferSlot.isInFlight)
         {
-            fseek(fp, 0, SEEK_END);
-            size = ftell(fp);
-
-            fclose(fp);
+            throw std::logic_error("Can't attach input of buffer slot " + std::to_string(bufferSlotIndex) + " while it is in flight!");
         }
-        else
+
+        unsigned int bufferSize = getBufferSize(getInputBufferParameter(inputIndex));
+        if (size < bufferSize)
         {
-            printf("Checking file %s failed.\n", name);
+            throw std::invalid_argument("Input memory of " + std::to_string(size) + " bytes is smaller than the " + std::to_string(bufferSize) + " bytes tensor!");
         }
-
-        return size;
     }
 
-    unsigned int load_file(const char *name, void *dst)
+    BufferSlot &getTicketBufferSlot(NeuralNetworkRuntime::Ticket ticket)
     {
-        FILE *fp = fopen(name, "rb");
-        unsigned int size = 0;
-
-        if (fp != NULL)
+        for (auto &bufferSlot : bufferSlots)
         {
-            fseek(fp, 0, SEEK_END);
-            size = ftell(fp);
-
-            fseek(fp, 0, SEEK_SET);
-            size = fread(dst, size, 1, fp);
-
-            fclose(fp);
+            if (ticket != 0 && bufferSlot.ticket == ticket)
+            {
+                return bufferSlot;
+            }
         }
 
-        return size;
+        throw std::invalid_argument("Invalid or expired ticket: " + std::to_string(ticket));
     }
 
-    std::vector<std::vector<float>> collectResults()
+    void waitPrepared()
     {
-
-        std::vector<vip_buffer>::size_type outputCount = outputBuffers.size();
-
-        std::vector<std::vector<float>> results(outputCount);
-
-        for (std::vector<vip_buffer>::size_type i = 0; i < outputCount; i++)
+        if (preparedFuture.valid())
         {
-            vip_buffer_create_params_t &bufferCreateParams = outputBufferParameters[i];
+            preparedFuture.wait();
+            preparedFuture = std::shared_future<void>();
+        }
+    }
 
-            vip_enum dataFormat = bufferCreateParams.data_format;
-            vip_enum quantFormat = bufferCreateParams.quant_format;
-            vip_int32_t fixed_point_pos = bufferCreateParams.quant_data.dfp.fixed_point_pos;
-            vip_float_t scale = bufferCreateParams.quant_data.affine.scale;
-            vip_int32_t zeroPoint = bufferCreateParams.quant_data.affine.zeroPoint;
+    void createNetworkInstances()
+    {
+        int networkInstanceCountPerDevice = config.isNetworkPerBufferSlot ? bufferSlots.size() : 1;
 
-            vip_uint32_t totalElementSize = 1;
-            for (int j = 0; j < bufferCreateParams.num_of_dims; j++)
+        for (int device = 0; device < (int)devices.size(); device++)
+        {
+            for (int i = 0; i < networkInstanceCountPerDevice; i++)
             {
-                totalElementSize *= bufferCreateParams.sizes[j];
+                NetworkInstance networkInstance;
+                networkInstance.boundInputBuffers.resize(inputBufferParameters.size(), nullptr);
+                networkInstance.boundOutputBuffers.resize(outputBufferParameters.size(), nullptr);
+
+                if (i == 0)
+                {
+                    networkInstance.network = deviceNetworks[device];
+                    networkInstances.push_back(networkInstance);
+                    continue;
+                }
+
+                // the copied command buffer keeps the device and priority of the prepared network
+                vip_status_e status = vip_weak_dup_network(deviceNetworks[device], &networkInstance.network);
+                CHECK_VIP_STATUS_WITH_MSG(status, "Can't duplicate network instance %d of device %d", i, device);
+
+                networkInstance.isDuplicate = true;
+                networkInstances.push_back(networkInstance);
+
+                // ignored by the driver if the duplicate is already prepared
+                status = vip_prepare_network(networkInstance.network);
+                CHECK_VIP_STATUS_WITH_MSG(status, "Can't prepare network instance %d of device %d", i, device);
             }
+        }
 
-            // vip_uint32_t formatSize = getFormatBytes(dataFormat);
-
-            // std::cout << "dataFormat: " << dataFormat << std::endl;
-            // std::cout << "quantFormat: " << quantFormat << std::endl;
-            // std::cout << "fixed_point_pos: " << fixed_point_pos << std::endl;
-            // std::cout << "scale: " << scale << std::endl;
-            // std::cout << "zeroPoint: " << zeroPoint << std::endl;
-
-            std::vector<float> result(totalElementSize);
+        for (int i = 0; i < (int)bufferSlots.size(); i++)
+        {
+            for (int device = 0; device < (int)devices.size(); device++)
+            {
+                bindBuffers(bufferSlots[i], networkInstances[getNetworkInstanceIndex(device, i)]);
+            }
 
-            vip_uint8_t *buffer = (vip_uint8_t *)vip_map_buffer(outputBuffers[i]);
+            bufferSlots[i].device = 0;
+            bufferSlots[i].networkInstance = getNetworkInstanceIndex(0, i);
+        }
+    }
 
-            std::vector<int16_t> shortBuffer(totalElementSize);
-            std::memcpy(shortBuffer.data(), buffer, totalElementSize * sizeof(int16_t));
+    // Creates the networks of the devices after the first from the loaded binary, like network.
+    void createDeviceNetworks()
+    {
+        deviceNetworks.assign(1, network);
 
-            float x;
-            if (fixed_point_pos > 0)
-            {
-                x = 1.0f / ((float)(1 << fixed_point_pos));
-            }
-            else if (fixed_point_pos < 0)
-            {
-                x = (float)(1 << -fixed_point_pos);
-            }
-            else {
-                x = 1;
-            }
-            
-            for (vip_uint32_t j = 0; j < totalElementSize; j++)
-            {
-                result[j] = (float)shortBuffer[j] * x;
-            }
+        for (vip_uint32_t deviceId = 1; deviceId < devices.size(); deviceId++)
+        {
+            vip_network deviceNetwork = nullptr;
+            vip_status_e status = createNetwork(&deviceNetwork);
+            CHECK_VIP_STATUS_WITH_MSG(status, "Can't create the network of device %u", deviceId);
 
-            vip_unmap_buffer(outputBuffers[i]);
+            deviceNetworks.push_back(deviceNetwork);
 
-            results[i] = std::move(result);
+            status = vip_set_network(deviceNetwork, VIP_NETWORK_PROP_SET_DEVICE_ID, &deviceId);
+            CHECK_VIP_STATUS_WITH_MSG(status, "Can't pin the network to device %u", deviceId);
         }
-
-        return results;
     }
 
-public:
-    Impl(Config &config)
-        : config(config)
+    void prepareDeviceNetworks()
     {
+        for (int i = 0; i < (int)deviceNetworks.size(); i++)
+        {
+            setNetworkPriority(deviceNetworks[i]);
 
+            vip_status_e status = vip_prepare_network(deviceNetworks[i]);
+            CHECK_VIP_STATUS_WITH_MSG(status, "Can't prepare the network of device %d", i);
+        }
     }
 
-    Impl(const Impl &other) = delete;
-    Impl &operator=(const Impl &other) = delete;
-
-    Impl(Impl &&other) noexcept
-        : config(std::move(other.config)),
-          network(other.network),
-          inputBuffers(std::move(other.inputBuffers)),
-          outputBufferParameters(std::move(other.outputBufferParameters)),
-          outputBuffers(std::move(outputBuffers))
+    // All but network, after their duplicates.
+    void destroyDeviceNetworks()
     {
-        other.network = nullptr;
-        for (auto &buffer : other.inputBuffers)
+        for (int i = 1; i < (int)deviceNetworks.size(); i++)
         {
-            buffer = nullptr;
+            vip_finish_network(deviceNetworks[i]);
+            vip_destroy_network(deviceNetworks[i]);
         }
-        for (auto &buffer : other.outputBuffers)
+
+        deviceNetworks.clear();
+    }
+
+    // Must happen before vip_prepare_network.
+    void setNetworkPriority(vip_network unpreparedNetwork)
+    {
+        if (config.priority < 0)
         {
-            buffer = nullptr;
+            return;
         }
+
+        vip_uint32_t priority = config.priority > 255 ? 255 : config.priority;
+        vip_status_e status = vip_set_network(unpreparedNetwork, VIP_NETWORK_PROP_SET_PRIORITY, &priority);
+        CHECK_VIP_STATUS_WITH_MSG(status, "Can't set network priority %u", priority);
     }
 
-    Impl &operator=(Impl &&other) noexcept
+    void destroyNetworkInstances()
     {
-        if (this != &other)
+        for (auto &batchGroup : batchGroups)
         {
-            config = std::move(other.config);
-            network = other.network;
-            inputBuffers = std::move(other.inputBuffers);
-            outputBufferParameters = std::move(other.outputBufferParameters);
-            outputBuffers = std::move(other.outputBuffers);
+            vip_destroy_group(batchGroup.group);
+        }
+        batchGroups.clear();
 
-            other.network = nullptr;
-            for (auto &buffer : other.inputBuffers)
-            {
-                buffer = nullptr;
-            }
-            for (auto &buffer : other.outputBuffers)
+        // the duplicates share the coefficients of the device networks, so they go first
+        for (auto &networkInstance : networkInstances)
+        {
+            if (networkInstance.isDuplicate)
             {
-                buffer = nullptr;
+                vip_finish_network(networkInstance.network);
+                vip_destroy_network(networkInstance.network);
             }
         }
-        return *this;
+
+        networkInstances.clear();
     }
 
-    void create()
+    // Only re-patches the command buffer for attachments which changed since the last submit.
+    void bindBuffers(BufferSlot &bufferSlot, NetworkInstance &networkInstance)
     {
-        std::cout << "NeuralNetworkRuntime Impl create..." << std::endl;
-
-        //TODO thread-safe
-        if (network != nullptr)
+        for (size_t i = 0; i < bufferSlot.inputBuffers.size(); i++)
         {
-            return;
-        }
+            if (networkInstance.boundInputBuffers[i] != bufferSlot.inputBuffers[i])
+            {
+                vip_status_e status = vip_set_input(networkInstance.network, i, bufferSlot.inputBuffers[i]);
+                CHECK_VIP_STATUS(status);
 
-        try {
-            vip_status_e status = vip_init(config.memSize);
-            CHECK_VIP_STATUS(status);
+                networkInstance.boundInputBuffers[i] = bufferSlot.inputBuffers[i];
+            }
+        }
 
-            int file_size = get_file_size(config.modelFilePath.c_str());
-            if (file_size <= 0)
+        for (size_t i = 0; i < bufferSlot.outputBuffers.size(); i++)
+        {
+            if (networkInstance.boundOutputBuffers[i] != bufferSlot.outputBuffers[i])
             {
-                printf("Network binary file %s can't be found.\n", config.modelFilePath.c_str());
-                status = VIP_ERROR_INVALID_ARGUMENTS;
+                vip_status_e status = vip_set_output(networkInstance.network, i, bufferSlot.outputBuffers[i]);
                 CHECK_VIP_STATUS(status);
-            }
 
-            void *networkBuffer = malloc(file_size);
-            load_file(config.modelFilePath.c_str(), networkBuffer);
-            status = vip_create_network(networkBuffer, file_size, VIP_CREATE_NETWORK_FROM_MEMORY, &network);
-            free(networkBuffer);
-            CHECK_VIP_STATUS(status);
+                networkInstance.boundOutputBuffers[i] = bufferSlot.outputBuffers[i];
+            }
+        }
+    }
 
-            createNeuralNetworkBuffers();
+    int getNetworkInstanceIndex(int device, int bufferSlotIndex) const
+    {
+        return config.isNetworkPerBufferSlot ? device * bufferSlots.size() + bufferSlotIndex : device;
+    }
 
-            std::cout << "vip_prepare_network start..." << std::endl;
-            status = vip_prepare_network(network);
-            std::cout << "vip_prepare_network finish" << std::endl;
-            CHECK_VIP_STATUS(status);
-        } 
-        catch(std::exception &e)
+    static vip_uint32_t queryDeviceCount()
+    {
+        vip_uint32_t deviceCount = 0;
+        vip_status_e status = vip_query_hardware(VIP_QUERY_HW_PROP_DEVICE_COUNT, sizeof(deviceCount), &deviceCount);
+        if (status != VIP_SUCCESS || deviceCount == 0)
         {
-            destroy();
-            throw e;
+            // drivers without multi device support run everything on device 0
+            deviceCount = 1;
         }
+
+        return deviceCount;
     }
 
-    std::vector<std::vector<float>> run(const NeuralNetworkRuntime::LoadingInputDataCallback& onLoadingInputData)
+    // the devices this runtime uses
+    vip_uint32_t getUsedDeviceCount(vip_uint32_t deviceCount) const
     {
-        vip_status_e status = VIP_SUCCESS;
+        return config.maxDeviceCount > 0 && deviceCount > config.maxDeviceCount ? config.maxDeviceCount : deviceCount;
+    }
 
-        loadInputData(onLoadingInputData);
+    void discoverDevices()
+    {
+        vip_uint32_t deviceCount = queryDeviceCount();
 
-        for (int i = 0; i < inputBuffers.size(); i++)
+        std::vector<vip_uint32_t> coreCounts(deviceCount, 1);
+        vip_status_e status = vip_query_hardware(VIP_QUERY_HW_PROP_CORE_COUNT_EACH_DEVICE, sizeof(vip_uint32_t) * deviceCount, coreCounts.data());
+        if (status != VIP_SUCCESS)
         {
-            status = vip_set_input(network, i, inputBuffers[i]);
-            CHECK_VIP_STATUS(status);
+            std::fill(coreCounts.begin(), coreCounts.end(), 1);
         }
 
-        for (int i = 0; i < outputBuffers.size(); i++)
-        {
-            status = vip_set_output(network, i, outputBuffers[i]);
-            CHECK_VIP_STATUS(status);
-        }
+        deviceCount = getUsedDeviceCount(deviceCount);
+
+        devices.assign(deviceCount, Device());
 
-        for (int i = 0; i < inputBuffers.size(); i++)
+        for (int i = 0; i < (int)devices.size(); i++)
         {
-            status = vip_flush_buffer(inputBuffers[i], VIP_BUFFER_OPER_TYPE_FLUSH);
-            CHECK_VIP_STATUS(status);
-        }
+            devices[i].coreCount = coreCounts[i] > 0 ? coreCounts[i] : 1;
 
-        status = vip_run_network(network);
-        CHECK_VIP_STATUS(status);
+            std::cout << "NeuralNetworkRuntime device " << i << ": " << devices[i].coreCount << " cores" << std::endl;
+        }
+    }
 
-        for (int i = 0; i < outputBuffers.size(); i++)
+    bool isAnyDeviceInFlight() const
+    {
+        for (auto &device : devices)
         {
-            status = vip_flush_buffer(outputBuffers[i], VIP_BUFFER_OPER_TYPE_INVALIDATE);
-            CHECK_VIP_STATUS(status);
+            if (!device.inFlightSlots.empty())
+            {
+                return true;
+            }
         }
 
-        // vip_inference_profile_t inferenceProfile;
-        // status = vip_query_network(network, VIP_NETWORK_PROP_PROFILING, &inferenceProfile);
-        // CHECK_VIP_STATUS(status);
-        // std::cout << "-----inferenceTime = " << inferenceProfile.inference_time << std::endl;
-
-        return collectResults();
+        return false;
     }
 
-    void destroy()
+    void waitDevice(std::unique_lock<std::mutex> &lock, int deviceIndex)
     {
-        if (network != nullptr)
+        while (!devices[deviceIndex].inFlightSlots.empty())
         {
-            vip_finish_network(network);
+            Device &device = devices[deviceIndex];
 
-            vip_destroy_network(network);
+            if (device.isWaiting)
+            {
+                // another thread is already blocked in vip_wait_network
+                waitingCondVar.wait(lock);
+                continue;
+            }
 
-            network = nullptr;
+            // inFlightSlots stays as is while waiting, nothing is submitted to a busy device
+            device.isWaiting = true;
+            vip_group inFlightGroup = device.inFlightGroup;
+            // a batch finishes with its last network, which also carries the profile
+            vip_network inFlightNetwork = networkInstances[bufferSlots[device.inFlightSlots.back()].networkInstance].network;
+            uint64_t submitTime = bufferSlots[device.inFlightSlots.front()].submitTime;
+            bool isResumed = device.isFirstInferenceAfterResume;
+            device.isFirstInferenceAfterResume = false;
+            lock.unlock();
+
+            vip_status_e status = inFlightGroup != nullptr ? vip_wait_group(inFlightGroup) : vip_wait_network(inFlightNetwork);
 
-            for (int i = 0; i < inputBuffers.size(); i++)
+            uint32_t inferenceTime = 0;
+            if (status == VIP_SUCCESS)
             {
-                vip_destroy_buffer(inputBuffers[i]);
-                inputBuffers[i] = nullptr;
+                status = recordInferenceStats(inFlightNetwork, submitTime, isResumed, inferenceTime);
             }
 
-            for (int i = 0; i < outputBuffers.size(); i++)
+            lock.lock();
+
+            if (!config.recordFilePath.empty() && status == VIP_SUCCESS && !devices[deviceIndex].isCancelled)
+            {
+                // the device is still waiting and its slots in flight, so the write doesn't need the lock
+                uint32_t submitToComplete = (get_perf_count() - submitTime) / 1000;
+                lock.unlock();
+                recordFinishedSlots(devices[deviceIndex], submitToComplete, config.isProfiling ? inferenceTime : 0);
+                lock.lock();
+            }
+
+            Device &finishedDevice = devices[deviceIndex];
+            finishedDevice.isWaiting = false;
+            lastActiveTime = get_perf_count();
+
+            bool isTimedOut = finishedDevice.isCancelled;
+            finishedDevice.isCancelled = false;
+
+            for (int bufferSlotIndex : finishedDevice.inFlightSlots)
+            {
+                bufferSlots[bufferSlotIndex].isInFlight = false;
+                // the status of a cancelled wait tells nothing, the error is reported to the owner of the ticket
+                bufferSlots[bufferSlotIndex].isTimedOut = isTimedOut;
+            }
+
+            finishedDevice.busyTime += lastActiveTime - submitTime;
+            finishedDevice.inferenceCount += finishedDevice.inFlightSlots.size();
+            // keeps its capacity for the next submit
+            finishedDevice.inFlightSlots.clear();
+            finishedDevice.inFlightGroup = nullptr;
+
+            waitingCondVar.notify_all();
+
+            if (isTimedOut)
+            {
+                timeoutCount.fetch_add(1);
+
+                // the other devices may still be running, the next submit rebuilds once they are done
+                isRebuildPending = config.isRebuildingAfterTimeout;
+                continue;
+            }
+
+            if (status == VIP_SUCCESS)
+            {
+                status = scaleClock(inferenceTime);
+            }
+
+            CHECK_VIP_STATUS(status);
+        }
+    }
+
+    void waitAllDevices(std::unique_lock<std::mutex> &lock)
+    {
+        for (int i = 0; i < (int)devices.size(); i++)
+        {
+            waitDevice(lock, i);
+
+            if (isAnyDeviceInFlight())
+            {
+                // submitted again while the lock was released
+                i = -1;
+            }
+        }
+    }
+
+    // Returns a device with nothing in flight, waiting for one if needed.
+    int selectDevice(std::unique_lock<std::mutex> &lock)
+    {
+        if (config.dispatchPolicy == NeuralNetworkRuntime::DISPATCH_ROUND_ROBIN)
+        {
+            int deviceIndex = nextDevice;
+            nextDevice = (nextDevice + 1) % devices.size();
+
+            waitDevice(lock, deviceIndex);
+            return deviceIndex;
+        }
+
+        while (true)
+        {
+            // the idle device which was busy the least per core, so faster devices get more frames
+            int selectedDevice = -1;
+            for (int i = 0; i < (int)devices.size(); i++)
+            {
+                if (devices[i].inFlightSlots.empty() &&
+                    (selectedDevice < 0 || devices[i].busyTime / devices[i].coreCount < devices[selectedDevice].busyTime / devices[selectedDevice].coreCount))
+                {
+                    selectedDevice = i;
+                }
+            }
+
+            if (selectedDevice >= 0)
+            {
+                return selectedDevice;
+            }
+
+            // all busy, the job submitted first should finish first
+            int oldestDevice = 0;
+            for (int i = 1; i < (int)devices.size(); i++)
+            {
+                if (bufferSlots[devices[i].inFlightSlots.front()].submitTime < bufferSlots[devices[oldestDevice].inFlightSlots.front()].submitTime)
+                {
+                    oldestDevice = i;
+                }
+            }
+
+            waitDevice(lock, oldestDevice);
+        }
+    }
+
+    void watchInFlight()
+    {
+        const uint64_t timeout = (uint64_t)config.inferenceTimeoutMs * 1000000;
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (!isWatchdogStopping)
+        {
+            uint64_t now = get_perf_count();
+            uint64_t nextCheck = 0;
+
+            for (auto &device : devices)
+            {
+                if (device.inFlightSlots.empty() || device.isCancelled)
+                {
+                    continue;
+                }
+
+                BufferSlot &bufferSlot = bufferSlots[device.inFlightSlots.front()];
+                uint64_t elapsed = now - bufferSlot.submitTime;
+
+                if (elapsed < timeout)
+                {
+                    if (nextCheck == 0 || timeout - elapsed < nextCheck)
+                    {
+                        nextCheck = timeout - elapsed;
+                    }
+                    continue;
+                }
+
+                std::cerr << "NeuralNetworkRuntime ticket " << bufferSlot.ticket << " is running for "
+                          << elapsed / 1000000 << " ms, cancel it" << std::endl;
+
+                // vip_wait_network of the waiting thread returns once the job is cancelled
+                for (int bufferSlotIndex : device.inFlightSlots)
+                {
+                    vip_cancel_network(networkInstances[bufferSlots[bufferSlotIndex].networkInstance].network);
+                }
+                device.isCancelled = true;
+            }
+
+            // a later submit or stop wakes this up early, the loop looks at the in-flight slots again
+            if (nextCheck == 0)
+            {
+                watchdogCondVar.wait(lock);
+            }
+            else
+            {
+                watchdogCondVar.wait_for(lock, std::chrono::nanoseconds(nextCheck));
+            }
+        }
+    }
+
+    void startWatchdog()
+    {
+        if (config.inferenceTimeoutMs == 0 || watchdogThread.joinable())
+        {
+            return;
+        }
+
+        isWatchdogStopping = false;
+        watchdogThread = std::thread(&Impl::watchInFlight, this);
+    }
+
+    void stopWatchdog()
+    {
+        if (!watchdogThread.joinable())
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isWatchdogStopping = true;
+        }
+        watchdogCondVar.notify_all();
+
+        watchdogThread.join();
+    }
+
+    // Power and frequency are per device, so they go through the first network instance of each device.
+    vip_status_e managePower(vip_enum property, void *value)
+    {
+        if (networkInstances.empty())
+        {
+            return vip_power_management(network, property, value);
+        }
+
+        for (int i = 0; i < (int)devices.size(); i++)
+        {
+            vip_status_e status = vip_power_management(networkInstances[getNetworkInstanceIndex(i, 0)].network, property, value);
+            if (status != VIP_SUCCESS)
+            {
+                return status;
+            }
+        }
+
+        return VIP_SUCCESS;
+    }
+
+    void watchIdle()
+    {
+        const uint64_t idlePeriod = (uint64_t)config.idlePowerOffMs * 1000000;
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (!isIdleStopping)
+        {
+            uint64_t idleTime = get_perf_count() - lastActiveTime;
+
+            if (isPoweredOff.load() || isAnyDeviceInFlight() || idleTime < idlePeriod || !isPrepared.load())
+            {
+                // nothing wakes this up but stop, the idle time is looked at again after a full period
+                uint64_t timeout = idleTime < idlePeriod ? idlePeriod - idleTime : idlePeriod;
+                idleCondVar.wait_for(lock, std::chrono::nanoseconds(timeout));
+                continue;
+            }
+
+            vip_status_e status = managePower(VIP_POWER_PROPERTY_OFF, nullptr);
+            if (status != VIP_SUCCESS)
+            {
+                // keep running powered on, and don't retry on every period
+                std::cerr << "NeuralNetworkRuntime can't power off the NPU, vip status: " << status << std::endl;
+                managePower(VIP_POWER_PROPERTY_ON, nullptr);
+                lastActiveTime = get_perf_count();
+                continue;
+            }
+
+            isPoweredOff.store(true);
+            powerOffCount.fetch_add(1);
+
+            std::cout << "NeuralNetworkRuntime NPU powered off after " << idleTime / 1000000 << " ms idle" << std::endl;
+        }
+    }
+
+    void startIdleMonitor()
+    {
+        if (config.idlePowerOffMs == 0 || idleThread.joinable())
+        {
+            return;
+        }
+
+        lastActiveTime = get_perf_count();
+        isIdleStopping = false;
+        idleThread = std::thread(&Impl::watchIdle, this);
+    }
+
+    void stopIdleMonitor()
+    {
+        if (!idleThread.joinable())
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isIdleStopping = true;
+        }
+        idleCondVar.notify_all();
+
+        idleThread.join();
+    }
+
+    // Called with mutex held.
+    void powerOn()
+    {
+        if (!isPoweredOff.load())
+        {
+            return;
+        }
+
+        uint64_t powerOnStartTime = get_perf_count();
+
+        vip_status_e status = managePower(VIP_POWER_PROPERTY_ON, nullptr);
+        CHECK_VIP_STATUS(status);
+
+        lastActiveTime = get_perf_count();
+        resumeTime.record((lastActiveTime - powerOnStartTime) / 1000);
+
+        isPoweredOff.store(false);
+        for (auto &device : devices)
+        {
+            device.isFirstInferenceAfterResume = true;
+        }
+
+        if (clockScalePercent.load() != 100)
+        {
+            // the frequency may not survive the power cycle
+            status = setClockScale(clockScalePercent.load());
+            CHECK_VIP_STATUS(status);
+        }
+    }
+
+    // Destroys the network and its duplicates, the buffers stay. Called with mutex held and nothing in flight.
+    void destroyNetwork()
+    {
+        destroyNetworkInstances();
+        destroyDeviceNetworks();
+
+        if (network != nullptr)
+        {
+            vip_finish_network(network);
+            vip_destroy_network(network);
+            network = nullptr;
+        }
+
+        if (isUsingSharedMemoryPool)
+        {
+            NpuContext::releaseMemoryPool();
+            isUsingSharedMemoryPool = false;
+        }
+    }
+
+    // Replaces the networks and their duplicates after a cancel, the buffers and their attachments are kept.
+    // If that fails nothing half built is left and isRebuildPending stays set, so the next submit tries again.
+    // Called with mutex held and nothing in flight.
+    void rebuildNetwork()
+    {
+        std::cerr << "NeuralNetworkRuntime rebuild network..." << std::endl;
+
+        uint64_t rebuildStartTime = get_perf_count();
+
+        isPrepared.store(false);
+        isRebuildPending = true;
+
+        destroyNetwork();
+
+        try
+        {
+            loadNetworkBinary();
+
+            try
+            {
+                vip_status_e status = createNetwork(&network);
+                if (status != VIP_SUCCESS)
+                {
+                    network = nullptr;
+                }
+                CHECK_VIP_STATUS(status);
+
+                createDeviceNetworks();
+            }
+            catch (...)
+            {
+                unloadNetworkBinary();
+                throw;
+            }
+            unloadNetworkBinary();
+
+            if (config.isSharedMemoryPool)
+            {
+                attachSharedMemoryPool();
+            }
+
+            prepareDeviceNetworks();
+
+            createNetworkInstances();
+        }
+        catch (...)
+        {
+            destroyNetwork();
+            throw;
+        }
+
+        isRebuildPending = false;
+        isPrepared.store(true);
+
+        uint64_t rebuiltTime = get_perf_count();
+        recoveryTime.record((rebuiltTime - rebuildStartTime) / 1000);
+
+        std::cerr << "NeuralNetworkRuntime network rebuilt in " << (rebuiltTime - rebuildStartTime) / 1000 << " us" << std::endl;
+    }
+
+    static TensorRecording::Tensor toRecordedTensor(const vip_buffer_create_params_t &bufferCreateParams)
+    {
+        TensorRecording::Tensor tensor;
+        memset(&tensor, 0, sizeof(tensor));
+
+        tensor.numOfDims = bufferCreateParams.num_of_dims;
+        memcpy(tensor.sizes, bufferCreateParams.sizes, sizeof(tensor.sizes));
+        tensor.dataFormat = bufferCreateParams.data_format;
+        tensor.quantFormat = bufferCreateParams.quant_format;
+        tensor.fixedPointPos = bufferCreateParams.quant_format == VIP_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT ? bufferCreateParams.quant_data.dfp.fixed_point_pos : 0;
+        tensor.scale = bufferCreateParams.quant_format == VIP_BUFFER_QUANTIZE_TF_ASYMM ? bufferCreateParams.quant_data.affine.scale : 1.0f;
+        tensor.zeroPoint = bufferCreateParams.quant_format == VIP_BUFFER_QUANTIZE_TF_ASYMM ? bufferCreateParams.quant_data.affine.zeroPoint : 0;
+        tensor.size = getBufferSize(bufferCreateParams);
+
+        return tensor;
+    }
+
+    void createRecordingWriter()
+    {
+        if (config.recordFilePath.empty())
+        {
+            return;
+        }
+
+        std::vector<TensorRecording::Tensor> inputs;
+        std::vector<TensorRecording::Tensor> outputs;
+
+        for (auto &bufferCreateParams : inputBufferParameters)
+        {
+            inputs.push_back(toRecordedTensor(bufferCreateParams));
+        }
+
+        for (auto &bufferCreateParams : outputBufferParameters)
+        {
+            outputs.push_back(toRecordedTensor(bufferCreateParams));
+        }
+
+        std::lock_guard<std::mutex> lock(recordingMutex);
+        recordingWriter.reset(new TensorRecording::Writer(config.recordFilePath, inputs, outputs, config.isRecordingInputs));
+        recordedInputs.resize(inputs.size());
+        recordedOutputs.resize(outputs.size());
+
+        std::cout << "NeuralNetworkRuntime records to " << config.recordFilePath << std::endl;
+    }
+
+    // Appends the inputs and raw outputs of the slots device just finished. Called without mutex, so the file write
+    // doesn't hold up the submits of the other devices, while the slots are still in flight and nothing else uses them.
+    void recordFinishedSlots(const Device &device, uint32_t submitToComplete, uint32_t npuTime)
+    {
+        std::lock_guard<std::mutex> lock(recordingMutex);
+
+        if (recordingWriter == nullptr)
+        {
+            return;
+        }
+
+        std::vector<const void *> &inputs = recordedInputs;
+        std::vector<const void *> &outputs = recordedOutputs;
+
+        try
+        {
+            for (int bufferSlotIndex : device.inFlightSlots)
+            {
+                BufferSlot &bufferSlot = bufferSlots[bufferSlotIndex];
+
+                std::fill(inputs.begin(), inputs.end(), nullptr);
+
+                if (config.isRecordingInputs)
+                {
+                    for (size_t i = 0; i < inputs.size(); i++)
+                    {
+                        // a dma-buf may not be mappable, it's recorded as zeros then
+                        inputs[i] = vip_map_buffer(bufferSlot.inputBuffers[i]);
+                    }
+                }
+
+                for (size_t i = 0; i < outputs.size(); i++)
+                {
+                    vip_flush_buffer(bufferSlot.outputBuffers[i], VIP_BUFFER_OPER_TYPE_INVALIDATE);
+                    outputs[i] = vip_map_buffer(bufferSlot.outputBuffers[i]);
+                }
+
+                TensorRecording::Frame frame;
+                frame.ticket = bufferSlot.ticket;
+                frame.submitTimeNs = bufferSlot.submitTime;
+                frame.submitToCompleteUs = submitToComplete;
+                frame.npuTimeUs = npuTime;
+
+                recordingWriter->write(frame, inputs.data(), outputs.data());
+
+                for (size_t i = 0; i < inputs.size(); i++)
+                {
+                    if (inputs[i] != nullptr)
+                    {
+                        vip_unmap_buffer(bufferSlot.inputBuffers[i]);
+                    }
+                }
+
+                for (size_t i = 0; i < outputs.size(); i++)
+                {
+                    if (outputs[i] != nullptr && bufferSlot.mappedOutputs[i] == nullptr)
+                    {
+                        vip_unmap_buffer(bufferSlot.outputBuffers[i]);
+                    }
+                }
+            }
+        }
+        catch (const std::exception &e)
+        {
+            // the inference itself is fine, only the recording stops
+            std::cerr << "NeuralNetworkRuntime recording stopped: " << e.what() << std::endl;
+            recordingWriter.reset();
+        }
+    }
+
+    // inferenceTime is the time the clock scaling looks at
+    vip_status_e recordInferenceStats(vip_network finishedNetwork, uint64_t submitTime, bool isResumed, uint32_t &inferenceTime)
+    {
+        uint32_t submitToComplete = (get_perf_count() - submitTime) / 1000;
+
+        submitToCompleteTime.record(submitToComplete);
+
+        if (isResumed)
+        {
+            // caches and clocks are cold after a power on
+            firstInferenceAfterResumeTime.record(submitToComplete);
+        }
+
+        // the clock only scales the NPU part, so the profiled time is preferred
+        inferenceTime = submitToComplete;
+
+        if (config.isProfiling)
+        {
+            vip_inference_profile_t inferenceProfile;
+            vip_status_e status = vip_query_network(finishedNetwork, VIP_NETWORK_PROP_PROFILING, &inferenceProfile);
+            if (status != VIP_SUCCESS)
+            {
+                return status;
+            }
+
+            npuInferenceTime.record(inferenceProfile.inference_time);
+            npuCycles.record(inferenceProfile.total_cycle);
+            // trigger, interrupt and wake-up latency of the driver
+            driverOverheadTime.record(submitToComplete > inferenceProfile.inference_time ? submitToComplete - inferenceProfile.inference_time : 0);
+
+            inferenceTime = inferenceProfile.inference_time;
+        }
+
+        return VIP_SUCCESS;
+    }
+
+    // Called with mutex held.
+    vip_status_e scaleClock(uint32_t inferenceTime)
+    {
+        unsigned int newClockScalePercent = clockScaler.update(inferenceTime);
+        if (newClockScalePercent != 0)
+        {
+            return setClockScale(newClockScalePercent);
+        }
+
+        return VIP_SUCCESS;
+    }
+
+    static ClockScaler::Config createClockScalerConfig(const NeuralNetworkRuntime::Config &config)
+    {
+        ClockScaler::Config clockScalerConfig;
+        clockScalerConfig.targetTimeUs = config.targetInferenceTimeUs;
+        clockScalerConfig.minScalePercent = config.minClockScalePercent;
+        return clockScalerConfig;
+    }
+
+    vip_status_e setClockScale(unsigned int scalePercent)
+    {
+        vip_power_frequency_t frequency;
+        frequency.fscale_percent = scalePercent;
+
+        vip_status_e status = managePower(VIP_POWER_PROPERTY_SET_FREQUENCY, &frequency);
+        if (status != VIP_SUCCESS)
+        {
+            return status;
+        }
+
+        clockScalePercent.store(scalePercent);
+        clockScaleChangeCount.fetch_add(1);
+
+        return VIP_SUCCESS;
+    }
+
+    BufferSlot &getFinishedBufferSlot(NeuralNetworkRuntime::Ticket ticket, std::unique_lock<std::mutex> &lock, bool isThrowingTimeout = true)
+    {
+        BufferSlot &bufferSlot = getTicketBufferSlot(ticket);
+
+        if (bufferSlot.isInFlight)
+        {
+            waitDevice(lock, bufferSlot.device);
+
+            if (bufferSlot.ticket != ticket)
+            {
+                throw std::logic_error("Buffer slot of ticket " + std::to_string(ticket) + " was submitted again while waiting!");
+            }
+        }
+
+        if (bufferSlot.isTimedOut && isThrowingTimeout)
+        {
+            throw InferenceTimeoutException(ticket, config.inferenceTimeoutMs);
+        }
+
+        return bufferSlot;
+    }
+
+    void unmapOutputs(BufferSlot &bufferSlot)
+    {
+        for (size_t i = 0; i < bufferSlot.outputBuffers.size(); i++)
+        {
+            if (bufferSlot.mappedOutputs[i] != nullptr)
+            {
+                vip_unmap_buffer(bufferSlot.outputBuffers[i]);
+                bufferSlot.mappedOutputs[i] = nullptr;
+            }
+        }
+    }
+
+    static bool hasMappedOutputs(const BufferSlot &bufferSlot)
+    {
+        for (auto mappedOutput : bufferSlot.mappedOutputs)
+        {
+            if (mappedOutput != nullptr)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static Dequantizer::Function selectDequantizer(vip_enum dataFormat)
+    {
+        switch (dataFormat)
+        {
+            case VIP_BUFFER_FORMAT_FP32:
+                return Dequantizer::fp32ToFp32;
+            case VIP_BUFFER_FORMAT_FP16:
+                return Dequantizer::fp16ToFp32;
+            case VIP_BUFFER_FORMAT_UINT8:
+                return Dequantizer::uint8ToFp32;
+            case VIP_BUFFER_FORMAT_INT8:
+                return Dequantizer::int8ToFp32;
+            case VIP_BUFFER_FORMAT_INT16:
+                return Dequantizer::int16ToFp32;
+            default:
+                return nullptr;
+        }
+    }
+
+    static NeuralNetworkRuntime::QuantFormat mapToQuantFormat(vip_enum quantFormat)
+    {
+        switch (quantFormat)
+        {
+            case VIP_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT:
+                return NeuralNetworkRuntime::QuantFormat::QUANT_DYNAMIC_FIXED_POINT;
+            case VIP_BUFFER_QUANTIZE_TF_ASYMM:
+                return NeuralNetworkRuntime::QuantFormat::QUANT_AFFINE;
+            case VIP_BUFFER_QUANTIZE_NONE:
+            default:
+                return NeuralNetworkRuntime::QuantFormat::QUANT_NONE;
+        }
+    }
+
+    NeuralNetworkRuntime::OutputTensor makeOutputTensor(int outputIndex, const void *data)
+    {
+        return makeTensor(outputBufferParameters[outputIndex], data);
+    }
+
+    static NeuralNetworkRuntime::OutputTensor makeTensor(const vip_buffer_create_params_t &bufferCreateParams, const void *data)
+    {
+        NeuralNetworkRuntime::OutputTensor outputTensor;
+        outputTensor.data = data;
+        outputTensor.dataFormat = mapToInputDataFormat(bufferCreateParams.data_format);
+        outputTensor.quantFormat = mapToQuantFormat(bufferCreateParams.quant_format);
+
+        switch (outputTensor.quantFormat)
+        {
+        case NeuralNetworkRuntime::QuantFormat::QUANT_DYNAMIC_FIXED_POINT:
+        {
+            int fixedPointPos = bufferCreateParams.quant_data.dfp.fixed_point_pos;
+            outputTensor.fixedPointPos = fixedPointPos;
+            outputTensor.scale = fixedPointPos > 0 ? 1.0f / (float)(1 << fixedPointPos) : (float)(1 << -fixedPointPos);
+            break;
+        }
+        case NeuralNetworkRuntime::QuantFormat::QUANT_AFFINE:
+            outputTensor.scale = bufferCreateParams.quant_data.affine.scale;
+            outputTensor.zeroPoint = bufferCreateParams.quant_data.affine.zeroPoint;
+            break;
+        default:
+            break;
+        }
+
+        outputTensor.numOfDims = bufferCreateParams.num_of_dims;
+        outputTensor.elementCount = 1;
+        for (vip_uint32_t i = 0; i < bufferCreateParams.num_of_dims; i++)
+        {
+            outputTensor.sizes[i] = bufferCreateParams.sizes[i];
+            outputTensor.elementCount *= bufferCreateParams.sizes[i];
+        }
+
+        return outputTensor;
+    }
+
+    static NeuralNetworkRuntime::InputDataFormat mapToInputDataFormat(vip_enum dataFormat)
+    {
+        NeuralNetworkRuntime::InputDataFormat format;
+
+        switch (dataFormat)
+        {
+            case VIP_BUFFER_FORMAT_FP32:
+                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_FP32;
+                break;
+            case VIP_BUFFER_FORMAT_FP16:
+                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_FP16;
+                break;
+            case VIP_BUFFER_FORMAT_UINT8:
+                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT8;
+                break;
+            case VIP_BUFFER_FORMAT_INT8:
+                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_INT8;
+                break;
+            case VIP_BUFFER_FORMAT_UINT16:
+                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT16;
+                break;
+            case VIP_BUFFER_FORMAT_INT16:
+                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_INT16;
+                break;
+            default:
+                format = NeuralNetworkRuntime::InputDataFormat::FORMAT_UNKNOWN;
+                break;
+        }
+
+        return format;
+    }
+
+    void loadInputData(BufferSlot &bufferSlot, const NeuralNetworkRuntime::LoadingInputDataCallback& onLoadingInputData)
+    {
+        std::vector<vip_buffer> &inputBuffers = bufferSlot.inputBuffers;
+
+        for (size_t i = 0; i < inputBuffers.size(); i++)
+        {
+            void *buffer = vip_map_buffer(inputBuffers[i]);
+
+            vip_buffer_create_params_t &bufferCreateParams = inputBufferParameters[i];
+
+            NeuralNetworkRuntime::InputDataFormat elementDataFormat = mapToInputDataFormat(bufferCreateParams.data_format);
+
+            onLoadingInputData(i, buffer, elementDataFormat);
+
+            vip_unmap_buffer(inputBuffers[i]);
+        }
+    }
+
+    static vip_uint32_t getFormatBytes(const vip_enum type)
+    {
+        switch (type)
+        {
+        case VIP_BUFFER_FORMAT_INT8:
+        case VIP_BUFFER_FORMAT_UINT8:
+            return 1;
+        case VIP_BUFFER_FORMAT_INT16:
+        case VIP_BUFFER_FORMAT_UINT16:
+        case VIP_BUFFER_FORMAT_FP16:
+        case VIP_BUFFER_FORMAT_BFP16:
+            return 2;
+        case VIP_BUFFER_FORMAT_FP32:
+        case VIP_BUFFER_FORMAT_INT32:
+        case VIP_BUFFER_FORMAT_UINT32:
+            return 4;
+        case VIP_BUFFER_FORMAT_FP64:
+        case VIP_BUFFER_FORMAT_INT64:
+        case VIP_BUFFER_FORMAT_UINT64:
+            return 8;
+
+        default:
+            return 0;
+        }
+    }
+
+    static vip_uint32_t getBufferSize(const vip_buffer_create_params_t &bufferCreateParams)
+    {
+        vip_uint32_t totalElementSize = 1;
+        for (vip_uint32_t i = 0; i < bufferCreateParams.num_of_dims; i++)
+        {
+            totalElementSize *= bufferCreateParams.sizes[i];
+        }
+
+        return totalElementSize * getFormatBytes(bufferCreateParams.data_format);
+    }
+
+    vip_status_e integer_convert(const void *src, void *dest, vip_enum src_dtype, vip_enum dst_dtype)
+    {
+        vip_status_e status = VIP_SUCCESS;
+
+        unsigned char all_zeros[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+        unsigned char all_ones[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+        vip_uint32_t src_sz = getFormatBytes(src_dtype);
+        vip_uint32_t dest_sz = getFormatBytes(dst_dtype);
+        unsigned char *buffer = all_zeros;
+        if (((vip_int8_t *)src)[src_sz - 1] & 0x80)
+        {
+            buffer = all_ones;
+        }
+        memcpy(buffer, src, src_sz);
+        memcpy(dest, buffer, dest_sz);
+
+        return status;
+    }
+
+
+    unsigned int get_file_size(const char *name)
+    {
+        FILE *fp = fopen(name, "rb");
+        unsigned int size = 0;
+
+        if (fp != NULL)
+        {
+            fseek(fp, 0, SEEK_END);
+            size = ftell(fp);
+
+            fclose(fp);
+        }
+        else
+        {
+            printf("Checking file %s failed.\n", name);
+        }
+
+        return size;
+    }
+
+    unsigned int load_file(const char *name, void *dst)
+    {
+        FILE *fp = fopen(name, "rb");
+        unsigned int size = 0;
+
+        if (fp != NULL)
+        {
+            fseek(fp, 0, SEEK_END);
+            size = ftell(fp);
+
+            fseek(fp, 0, SEEK_SET);
+            size = fread(dst, size, 1, fp);
+
+            fclose(fp);
+        }
+
+        return size;
+    }
+
+    void loadNetworkBinary()
+    {
+        const char *modelFilePath = config.modelFilePath.c_str();
+
+        if (config.modelLoadMode == NeuralNetworkRuntime::ModelLoadMode::MODEL_LOAD_READ)
+        {
+            networkBinarySize = get_file_size(modelFilePath);
+            if (networkBinarySize > 0)
+            {
+                networkBinary = malloc(networkBinarySize);
+                CHECK_NULL_PTR(networkBinary);
+                load_file(modelFilePath, networkBinary);
+            }
+        }
+        else
+        {
+            int fd = open(modelFilePath, O_RDONLY);
+            struct stat fileStat;
+            if (fd >= 0 && fstat(fd, &fileStat) == 0)
+            {
+                networkBinarySize = fileStat.st_size;
+            }
+
+            if (fd >= 0 && networkBinarySize > 0 && config.modelLoadMode == NeuralNetworkRuntime::ModelLoadMode::MODEL_LOAD_MMAP)
+            {
+                void *mapped = mmap(nullptr, networkBinarySize, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED)
+                {
+                    // the driver reads the binary front to back exactly once
+                    madvise(mapped, networkBinarySize, MADV_SEQUENTIAL);
+                    madvise(mapped, networkBinarySize, MADV_WILLNEED);
+                    networkBinary = mapped;
+                }
+            }
+
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+
+        bool isLoaded = networkBinarySize > 0
+            && (networkBinary != nullptr || config.modelLoadMode == NeuralNetworkRuntime::ModelLoadMode::MODEL_LOAD_FROM_FILE);
+        if (!isLoaded)
+        {
+            unloadNetworkBinary();
+            printf("Network binary file %s can't be loaded.\n", modelFilePath);
+            vip_status_e status = VIP_ERROR_INVALID_ARGUMENTS;
+            CHECK_VIP_STATUS(status);
+        }
+    }
+
+    void unloadNetworkBinary()
+    {
+        if (networkBinary != nullptr)
+        {
+            if (config.modelLoadMode == NeuralNetworkRuntime::ModelLoadMode::MODEL_LOAD_MMAP)
+            {
+                munmap(networkBinary, networkBinarySize);
+            }
+            else
+            {
+                free(networkBinary);
+            }
+        }
+
+        networkBinary = nullptr;
+    }
+
+    vip_status_e createNetwork(vip_network *createdNetwork)
+    {
+        if (config.modelLoadMode == NeuralNetworkRuntime::ModelLoadMode::MODEL_LOAD_FROM_FILE)
+        {
+            return vip_create_network(config.modelFilePath.c_str(), 0, VIP_CREATE_NETWORK_FROM_FILE, createdNetwork);
+        }
+
+        return vip_create_network(networkBinary, networkBinarySize, VIP_CREATE_NETWORK_FROM_MEMORY, createdNetwork);
+    }
+
+    void dequantize(int outputIndex, const NeuralNetworkRuntime::OutputTensor &outputTensor, std::vector<float> &result)
+    {
+        Dequantizer::Function dequantizer = outputDequantizers[outputIndex];
+
+        if (dequantizer == nullptr)
+        {
+            throw std::invalid_argument("Can't convert output " + std::to_string(outputIndex) + " of data format " + std::to_string(outputTensor.dataFormat) + " to fp32!");
+        }
+
+        // same size every time, so only the first inference allocates
+        result.resize(outputTensor.elementCount);
+
+        dequantizer(outputTensor.data, result.data(), outputTensor.elementCount, outputTensor.scale, outputTensor.zeroPoint);
+    }
+
+public:
+    Impl(Config &config)
+        : config(config),
+          clockScaler(createClockScalerConfig(config))
+    {
+
+    }
+
+    Impl(const Impl &other) = delete;
+    Impl &operator=(const Impl &other) = delete;
+
+    // NeuralNetworkRuntime moves the pointer, the background prepare and the monitor threads keep this object
+    Impl(Impl &&other) = delete;
+    Impl &operator=(Impl &&other) = delete;
+
+    void create()
+    {
+        std::cout << "NeuralNetworkRuntime Impl create..." << std::endl;
+
+        //TODO thread-safe
+        if (network != nullptr)
+        {
+            return;
+        }
+
+        try {
+            createNetworkObjects();
+            prepareNetwork();
+        } 
+        catch(...)
+        {
+            destroy();
+            throw;
+        }
+    }
+
+    std::shared_future<void> createAsync()
+    {
+        std::cout << "NeuralNetworkRuntime Impl createAsync..." << std::endl;
+
+        if (network != nullptr)
+        {
+            return preparedFuture;
+        }
+
+        // vip_init stays in the calling thread, only the prepare runs in the background
+        try {
+            createNetworkObjects();
+        }
+        catch(...)
+        {
+            destroy();
+            throw;
+        }
+
+        preparedFuture = std::async(std::launch::async, [this]() {
+            try {
+                this->prepareNetwork();
+            }
+            catch (...)
+            {
+                // the networks go right away, the buffers may still be attached and loaded meanwhile, so destroy() frees them
+                isPrepared.store(false);
+                stopWatchdog();
+                stopIdleMonitor();
+
+                std::lock_guard<std::mutex> lock(mutex);
+                destroyNetworkInstances();
+                destroyDeviceNetworks();
+                throw;
+            }
+        }).share();
+
+        return preparedFuture;
+    }
+
+    void createNetworkObjects()
+    {
+        if (config.bufferSlotCount == 0)
+        {
+            throw std::invalid_argument("bufferSlotCount must be at least 1!");
+        }
+
+        createStartTime = get_perf_count();
+
+        loadNetworkBinary();
+
+        uint64_t loadedTime = get_perf_count();
+
+        vip_status_e status = VIP_SUCCESS;
+        try {
+            unsigned int memSize = config.memSize;
+            if (NpuContext::isInitialized())
+            {
+                std::cout << "NeuralNetworkRuntime uses the NPU context of " << NpuContext::getMemSize() << " bytes" << std::endl;
+            }
+            else if (memSize == NeuralNetworkRuntime::MEM_SIZE_AUTO)
+            {
+                memSize = measureMemSize();
+            }
+
+            NpuContext::acquire(memSize);
+            hasNpuContext = true;
+
+            discoverDevices();
+        }
+        catch (...)
+        {
+            unloadNetworkBinary();
+            throw;
+        }
+
+        uint64_t networkCreateStartTime = get_perf_count();
+
+        status = createNetwork(&network);
+        if (status != VIP_SUCCESS)
+        {
+            unloadNetworkBinary();
+            network = nullptr;
+            NpuContext::release();
+            hasNpuContext = false;
+        }
+        CHECK_VIP_STATUS(status);
+
+        try {
+            createDeviceNetworks();
+        }
+        catch (...)
+        {
+            unloadNetworkBinary();
+            throw;
+        }
+
+        // the driver keeps its own copy of the binary
+        unloadNetworkBinary();
+
+        uint64_t createdTime = get_perf_count();
+
+        if (config.isSharedMemoryPool)
+        {
+            attachSharedMemoryPool();
+        }
+
+        createNeuralNetworkBuffers();
+
+        createRecordingWriter();
+
+        std::cout << "NeuralNetworkRuntime load: " << (loadedTime - createStartTime) / 1000 << " us"
+                  << ", create: " << (createdTime - networkCreateStartTime) / 1000 << " us" << std::endl;
+    }
+
+    void prepareNetwork()
+    {
+        std::cout << "vip_prepare_network start..." << std::endl;
+        uint64_t prepareStartTime = get_perf_count();
+        prepareDeviceNetworks();
+        std::cout << "vip_prepare_network finish" << std::endl;
+
+        {
+            // may run in the background of createAsync while buffers are attached
+            std::lock_guard<std::mutex> lock(mutex);
+
+            createNetworkInstances();
+        }
+
+        uint64_t preparedTime = get_perf_count();
+
+        isPrepared.store(true);
+
+        startWatchdog();
+        startIdleMonitor();
+
+        std::cout << "NeuralNetworkRuntime prepare: " << (preparedTime - prepareStartTime) / 1000 << " us"
+                  << ", ready after " << (preparedTime - createStartTime) / 1000 << " us" << std::endl;
+    }
+
+    std::vector<std::vector<float>> run(const NeuralNetworkRuntime::LoadingInputDataCallback& onLoadingInputData)
+    {
+        loadInput(0, onLoadingInputData);
+
+        return wait(submit(0));
+    }
+
+    void run(const NeuralNetworkRuntime::LoadingInputDataCallback& onLoadingInputData, std::vector<std::vector<float>> &results)
+    {
+        loadInput(0, onLoadingInputData);
+
+        wait(submit(0), results);
+    }
+
+    int getBufferSlotCount() const
+    {
+        return bufferSlots.size();
+    }
+
+    int getDeviceCount() const
+    {
+        return devices.size();
+    }
+
+    unsigned int getInputBufferSize(int inputIndex) const
+    {
+        return getBufferSize(getInputBufferParameter(inputIndex));
+    }
+
+    NeuralNetworkRuntime::InputDataFormat getInputDataFormat(int inputIndex) const
+    {
+        return mapToInputDataFormat(getInputBufferParameter(inputIndex).data_format);
+    }
+
+    NeuralNetworkRuntime::OutputTensor getInputTensor(int inputIndex) const
+    {
+        return makeTensor(getInputBufferParameter(inputIndex), nullptr);
+    }
+
+    void attachInputHandle(int bufferSlotIndex, int inputIndex, void *handle, unsigned int size)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        checkExternalInputMemory(bufferSlotIndex, inputIndex, size);
+
+        vip_buffer_create_params_t bufferCreateParams = inputBufferParameters[inputIndex];
+        bufferCreateParams.memory_type = VIP_BUFFER_MEMORY_TYPE_HOST;
+
+        vip_buffer inputBuffer;
+        vip_status_e status = vip_create_buffer_from_handle(&bufferCreateParams, handle, size, &inputBuffer);
+        CHECK_VIP_STATUS_WITH_MSG(status, "Can't create input %d of buffer slot %d from handle %p", inputIndex, bufferSlotIndex, handle);
+
+        replaceInputBuffer(bufferSlotIndex, inputIndex, inputBuffer, VIP_BUFFER_MEMORY_TYPE_HOST);
+    }
+
+    void attachInputFd(int bufferSlotIndex, int inputIndex, int fd, unsigned int size)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        checkExternalInputMemory(bufferSlotIndex, inputIndex, size);
+
+        vip_buffer_create_params_t bufferCreateParams = inputBufferParameters[inputIndex];
+        bufferCreateParams.memory_type = VIP_BUFFER_MEMORY_TYPE_DMA_BUF;
+
+        vip_buffer inputBuffer;
+        vip_status_e status = vip_create_buffer_from_fd(&bufferCreateParams, fd, size, &inputBuffer);
+        CHECK_VIP_STATUS_WITH_MSG(status, "Can't create input %d of buffer slot %d from fd %d", inputIndex, bufferSlotIndex, fd);
+
+        replaceInputBuffer(bufferSlotIndex, inputIndex, inputBuffer, VIP_BUFFER_MEMORY_TYPE_DMA_BUF);
+    }
+
+    void loadInput(int bufferSlotIndex, const NeuralNetworkRuntime::LoadingInputDataCallback& onLoadingInputData)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        BufferSlot &bufferSlot = getBufferSlot(bufferSlotIndex);
+
+        if (bufferSlot.isInFlight)
+        {
+            throw std::logic_error("Can't load input of buffer slot " + std::to_string(bufferSlotIndex) + " while it is in flight!");
+        }
+
+        lock.unlock();
+
+        loadInputData(bufferSlot, onLoadingInputData);
+    }
+
+    NeuralNetworkRuntime::Ticket submit(int bufferSlotIndex, int deviceIndex = -1)
+    {
+        NeuralNetworkRuntime::Ticket ticket;
+
+        submitBatch(&bufferSlotIndex, 1, &ticket, deviceIndex);
+
+        return ticket;
+    }
+
+    std::vector<NeuralNetworkRuntime::Ticket> submitBatch(const std::vector<int> &bufferSlotIndexes)
+    {
+        std::vector<NeuralNetworkRuntime::Ticket> tickets(bufferSlotIndexes.size());
+
+        submitBatch(bufferSlotIndexes.data(), bufferSlotIndexes.size(), tickets.data());
+
+        return tickets;
+    }
+
+    // Returns the group of the network instances of bufferSlotIndexes on deviceIndex, called with mutex held.
+    vip_group getBatchGroup(int deviceIndex, const int *bufferSlotIndexes, int count)
+    {
+        for (auto &batchGroup : batchGroups)
+        {
+            if (batchGroup.device == deviceIndex &&
+                (int)batchGroup.bufferSlots.size() >= count &&
+                std::equal(bufferSlotIndexes, bufferSlotIndexes + count, batchGroup.bufferSlots.begin()))
+            {
+                return batchGroup.group;
+            }
+        }
+
+        BatchGroup batchGroup;
+        batchGroup.device = deviceIndex;
+        batchGroup.bufferSlots.assign(bufferSlotIndexes, bufferSlotIndexes + count);
+
+        vip_status_e status = vip_create_group(count, &batchGroup.group);
+        CHECK_VIP_STATUS(status);
+
+        for (int bufferSlotIndex : batchGroup.bufferSlots)
+        {
+            status = vip_add_network(batchGroup.group, networkInstances[getNetworkInstanceIndex(deviceIndex, bufferSlotIndex)].network);
+            if (status != VIP_SUCCESS)
+            {
+                vip_destroy_group(batchGroup.group);
+            }
+            CHECK_VIP_STATUS_WITH_MSG(status, "Can't add buffer slot %d to a batch group", bufferSlotIndex);
+        }
+
+        batchGroups.push_back(batchGroup);
+
+        return batchGroup.group;
+    }
+
+    bool isAnyBufferSlotInFlight(const int *bufferSlotIndexes, int count, int *inFlightDevice)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (bufferSlots[bufferSlotIndexes[i]].isInFlight)
             {
-                vip_destroy_buffer(outputBuffers[i]);
-                outputBuffers[i] = nullptr;
+                *inFlightDevice = bufferSlots[bufferSlotIndexes[i]].device;
+                return true;
             }
+        }
 
-            vip_destroy();
+        return false;
+    }
+
+    // Doesn't allocate once the batch group and the in-flight list of the device are there.
+    // deviceIndex -1 selects a device by config.dispatchPolicy.
+    void submitBatch(const int *bufferSlotIndexes, int count, NeuralNetworkRuntime::Ticket *tickets, int deviceIndex = -1)
+    {
+        if (count == 0)
+        {
+            throw std::invalid_argument("Can't submit an empty batch!");
+        }
+
+        if (count > 1 && !config.isNetworkPerBufferSlot)
+        {
+            throw std::logic_error("Batch submission needs isNetworkPerBufferSlot!");
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // a failed rebuild leaves the network unprepared, the submit tries it again
+        if (!isPrepared.load() && !isRebuildPending)
+        {
+            throw std::logic_error("Can't submit before the network is prepared!");
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            getBufferSlot(bufferSlotIndexes[i]);
+
+            if (std::find(bufferSlotIndexes, bufferSlotIndexes + i, bufferSlotIndexes[i]) != bufferSlotIndexes + i)
+            {
+                throw std::invalid_argument("Buffer slot " + std::to_string(bufferSlotIndexes[i]) + " is twice in the batch!");
+            }
+        }
+
+        if (deviceIndex >= (int)devices.size())
+        {
+            throw std::out_of_range("Invalid device: " + std::to_string(deviceIndex));
+        }
+
+        int inFlightDevice = 0;
+        while (isAnyBufferSlotInFlight(bufferSlotIndexes, count, &inFlightDevice))
+        {
+            waitDevice(lock, inFlightDevice);
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            int bufferSlotIndex = bufferSlotIndexes[i];
+            if (hasMappedOutputs(bufferSlots[bufferSlotIndex]))
+            {
+                throw std::logic_error("Can't submit buffer slot " + std::to_string(bufferSlotIndex) + " before its outputs are released!");
+            }
+        }
+
+        if (isRebuildPending)
+        {
+            waitAllDevices(lock);
+
+            if (isRebuildPending)
+            {
+                rebuildNetwork();
+            }
+        }
+
+        powerOn();
+
+        // every device runs one inference or batch at a time
+        if (deviceIndex < 0)
+        {
+            deviceIndex = selectDevice(lock);
+        }
+        else
+        {
+            waitDevice(lock, deviceIndex);
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            int bufferSlotIndex = bufferSlotIndexes[i];
+            if (bufferSlots[bufferSlotIndex].isInFlight || hasMappedOutputs(bufferSlots[bufferSlotIndex]))
+            {
+                throw std::logic_error("Buffer slot " + std::to_string(bufferSlotIndex) + " was submitted or mapped by another thread while waiting!");
+            }
+        }
+
+        vip_group group = count > 1 ? getBatchGroup(deviceIndex, bufferSlotIndexes, count) : nullptr;
+
+        vip_status_e status = VIP_SUCCESS;
+
+        uint64_t flushStartTime = get_perf_count();
+
+        for (int i = 0; i < count; i++)
+        {
+            int bufferSlotIndex = bufferSlotIndexes[i];
+            BufferSlot &bufferSlot = bufferSlots[bufferSlotIndex];
+
+            bufferSlot.device = deviceIndex;
+            bufferSlot.networkInstance = getNetworkInstanceIndex(deviceIndex, bufferSlotIndex);
+
+            bindBuffers(bufferSlot, networkInstances[bufferSlot.networkInstance]);
+
+            std::vector<vip_buffer> &inputBuffers = bufferSlot.inputBuffers;
+
+            for (size_t i = 0; i < inputBuffers.size(); i++)
+            {
+                // the driver can't maintain the CPU cache of a dma-buf
+                if (bufferSlot.inputMemoryTypes[i] == VIP_BUFFER_MEMORY_TYPE_DMA_BUF)
+                {
+                    continue;
+                }
+
+                status = vip_flush_buffer(inputBuffers[i], VIP_BUFFER_OPER_TYPE_FLUSH);
+                CHECK_VIP_STATUS(status);
+            }
+
+            bufferSlot.ticket = 0;
+            bufferSlot.isTimedOut = false;
+        }
+
+        uint64_t submitTime = get_perf_count();
+
+        inputFlushTime.record((submitTime - flushStartTime) / 1000);
+
+        if (group != nullptr)
+        {
+            // a single interrupt once the last one is done
+            status = vip_trigger_group(group, count);
+        }
+        else
+        {
+            status = vip_trigger_network(networkInstances[bufferSlots[bufferSlotIndexes[0]].networkInstance].network);
+        }
+        CHECK_VIP_STATUS(status);
+
+        for (int i = 0; i < count; i++)
+        {
+            BufferSlot &bufferSlot = bufferSlots[bufferSlotIndexes[i]];
+
+            bufferSlot.submitTime = submitTime;
+            bufferSlot.ticket = ++lastTicket;
+            bufferSlot.isInFlight = true;
+
+            tickets[i] = bufferSlot.ticket;
+        }
+
+        devices[deviceIndex].inFlightSlots.assign(bufferSlotIndexes, bufferSlotIndexes + count);
+        devices[deviceIndex].inFlightGroup = group;
+
+        watchdogCondVar.notify_all();
+    }
+
+    std::vector<std::vector<float>> wait(NeuralNetworkRuntime::Ticket ticket)
+    {
+        std::vector<std::vector<float>> results;
+
+        wait(ticket, results);
+
+        return results;
+    }
+
+    void wait(NeuralNetworkRuntime::Ticket ticket, std::vector<std::vector<float>> &results)
+    {
+        results.resize(outputBufferParameters.size());
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            dequantize(i, mapOutput(ticket, i), results[i]);
+        }
+
+        releaseOutputs(ticket);
+    }
+
+    int getOutputCount() const
+    {
+        return outputBufferParameters.size();
+    }
+
+    NeuralNetworkRuntime::OutputTensor mapOutput(NeuralNetworkRuntime::Ticket ticket, int outputIndex)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (outputIndex < 0 || outputIndex >= (int)outputBufferParameters.size())
+        {
+            throw std::out_of_range("Invalid output index: " + std::to_string(outputIndex));
+        }
+
+        BufferSlot &bufferSlot = getFinishedBufferSlot(ticket, lock);
+
+        void *&mappedOutput = bufferSlot.mappedOutputs[outputIndex];
+
+        if (mappedOutput == nullptr)
+        {
+            vip_buffer outputBuffer = bufferSlot.outputBuffers[outputIndex];
+
+            uint64_t mapStartTime = get_perf_count();
+
+            vip_status_e status = vip_flush_buffer(outputBuffer, VIP_BUFFER_OPER_TYPE_INVALIDATE);
+            CHECK_VIP_STATUS(status);
+
+            void *buffer = vip_map_buffer(outputBuffer);
+            CHECK_NULL_PTR(buffer);
+
+            mappedOutput = buffer;
+
+            outputMapTime.record((get_perf_count() - mapStartTime) / 1000);
+        }
+
+        return makeOutputTensor(outputIndex, mappedOutput);
+    }
+
+    void waitFinished(NeuralNetworkRuntime::Ticket ticket)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        getFinishedBufferSlot(ticket, lock);
+    }
+
+    void releaseOutputs(NeuralNetworkRuntime::Ticket ticket)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        BufferSlot &bufferSlot = getFinishedBufferSlot(ticket, lock, false);
+
+        unmapOutputs(bufferSlot);
+
+        bufferSlot.ticket = 0;
+        bufferSlot.isTimedOut = false;
+    }
+
+    NeuralNetworkRuntime::Stats stats() const
+    {
+        NeuralNetworkRuntime::Stats stats;
+
+        getStats(stats);
+
+        return stats;
+    }
+
+    void getStats(NeuralNetworkRuntime::Stats &stats) const
+    {
+        stats.npuInferenceTime = npuInferenceTime.getPercentiles();
+        stats.npuCycles = npuCycles.getPercentiles();
+        stats.submitToCompleteTime = submitToCompleteTime.getPercentiles();
+        stats.driverOverheadTime = driverOverheadTime.getPercentiles();
+        stats.inputFlushTime = inputFlushTime.getPercentiles();
+        stats.outputMapTime = outputMapTime.getPercentiles();
+        stats.recoveryTime = recoveryTime.getPercentiles();
+        stats.timeoutCount = timeoutCount.load();
+        stats.clockScalePercent = clockScalePercent.load();
+        stats.clockScaleChangeCount = clockScaleChangeCount.load();
+        stats.resumeTime = resumeTime.getPercentiles();
+        stats.firstInferenceAfterResumeTime = firstInferenceAfterResumeTime.getPercentiles();
+        stats.powerOffCount = powerOffCount.load();
+        stats.isPoweredOff = isPoweredOff.load();
+
+        // device state is guarded by the mutex, the counters are only a snapshot anyway
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.deviceInferenceCounts.resize(devices.size());
+        for (int i = 0; i < (int)devices.size(); i++)
+        {
+            stats.deviceInferenceCounts[i] = devices[i].inferenceCount;
+        }
+    }
+
+    void resetStats()
+    {
+        npuInferenceTime.reset();
+        npuCycles.reset();
+        submitToCompleteTime.reset();
+        driverOverheadTime.reset();
+        inputFlushTime.reset();
+        outputMapTime.reset();
+        recoveryTime.reset();
+        timeoutCount.store(0);
+        clockScaleChangeCount.store(0);
+        resumeTime.reset();
+        firstInferenceAfterResumeTime.reset();
+        powerOffCount.store(0);
+    }
+
+    void destroy()
+    {
+        // a background prepare must not outlive the network
+        waitPrepared();
+
+        isPrepared.store(false);
+
+        if (!hasNpuContext)
+        {
+            return;
+        }
+
+        for (auto &device : devices)
+        {
+            if (!device.inFlightSlots.empty())
+            {
+                // the watchdog still cancels a stalled inference here
+                if (device.inFlightGroup != nullptr)
+                {
+                    vip_wait_group(device.inFlightGroup);
+                }
+                else
+                {
+                    vip_wait_network(networkInstances[bufferSlots[device.inFlightSlots.front()].networkInstance].network);
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                for (int bufferSlotIndex : device.inFlightSlots)
+                {
+                    bufferSlots[bufferSlotIndex].isInFlight = false;
+                }
+                device.inFlightSlots.clear();
+                device.inFlightGroup = nullptr;
+                device.isCancelled = false;
+            }
+        }
+
+        stopWatchdog();
+        stopIdleMonitor();
+
+        if (network != nullptr)
+        {
+            // the network can't be finished on a powered off NPU
+            try {
+                std::lock_guard<std::mutex> lock(mutex);
+                powerOn();
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "NeuralNetworkRuntime destroy: " << e.what() << std::endl;
+            }
+
+            if (clockScalePercent.load() != 100)
+            {
+                // the frequency belongs to the device, give the next user the full clock
+                setClockScale(100);
+                clockScaler.reset();
+            }
+
+            destroyNetworkInstances();
+            destroyDeviceNetworks();
+
+            vip_finish_network(network);
+
+            vip_destroy_network(network);
+
+            network = nullptr;
+        }
+
+        for (auto &bufferSlot : bufferSlots)
+        {
+            unmapOutputs(bufferSlot);
+
+            for (size_t i = 0; i < bufferSlot.inputBuffers.size(); i++)
+            {
+                vip_destroy_buffer(bufferSlot.inputBuffers[i]);
+                bufferSlot.inputBuffers[i] = nullptr;
+            }
+
+            for (size_t i = 0; i < bufferSlot.outputBuffers.size(); i++)
+            {
+                vip_destroy_buffer(bufferSlot.outputBuffers[i]);
+                bufferSlot.outputBuffers[i] = nullptr;
+            }
+        }
+
+        bufferSlots.clear();
+        inputBufferParameters.clear();
+        outputBufferParameters.clear();
+        outputDequantizers.clear();
+        devices.clear();
+        nextDevice = 0;
+        isRebuildPending = false;
+        {
+            std::lock_guard<std::mutex> recordingLock(recordingMutex);
+            recordingWriter.reset();
+        }
+
+        if (isUsingSharedMemoryPool)
+        {
+            NpuContext::releaseMemoryPool();
+            isUsingSharedMemoryPool = false;
         }
+
+        NpuContext::release();
+        hasNpuContext = false;
     }
 
     ~Impl()
@@ -626,11 +2407,121 @@ void NeuralNetworkRuntime::create()
     _pImpl->create();
 }
 
+std::shared_future<void> NeuralNetworkRuntime::createAsync()
+{
+    return _pImpl->createAsync();
+}
+
 std::vector<std::vector<float>> NeuralNetworkRuntime::run(const LoadingInputDataCallback& onLoadingInputData)
 {
     return _pImpl->run(onLoadingInputData);
 }
 
+void NeuralNetworkRuntime::run(const LoadingInputDataCallback& onLoadingInputData, std::vector<std::vector<float>> &results)
+{
+    _pImpl->run(onLoadingInputData, results);
+}
+
+int NeuralNetworkRuntime::getBufferSlotCount() const
+{
+    return _pImpl->getBufferSlotCount();
+}
+
+int NeuralNetworkRuntime::getDeviceCount() const
+{
+    return _pImpl->getDeviceCount();
+}
+
+unsigned int NeuralNetworkRuntime::getInputBufferSize(int inputIndex) const
+{
+    return _pImpl->getInputBufferSize(inputIndex);
+}
+
+NeuralNetworkRuntime::InputDataFormat NeuralNetworkRuntime::getInputDataFormat(int inputIndex) const
+{
+    return _pImpl->getInputDataFormat(inputIndex);
+}
+
+NeuralNetworkRuntime::OutputTensor NeuralNetworkRuntime::getInputTensor(int inputIndex) const
+{
+    return _pImpl->getInputTensor(inputIndex);
+}
+
+void NeuralNetworkRuntime::attachInputHandle(int bufferSlot, int inputIndex, void *handle, unsigned int size)
+{
+    _pImpl->attachInputHandle(bufferSlot, inputIndex, handle, size);
+}
+
+void NeuralNetworkRuntime::attachInputFd(int bufferSlot, int inputIndex, int fd, unsigned int size)
+{
+    _pImpl->attachInputFd(bufferSlot, inputIndex, fd, size);
+}
+
+void NeuralNetworkRuntime::loadInput(int bufferSlot, const LoadingInputDataCallback& onLoadingInputData)
+{
+    _pImpl->loadInput(bufferSlot, onLoadingInputData);
+}
+
+NeuralNetworkRuntime::Ticket NeuralNetworkRuntime::submit(int bufferSlot)
+{
+    return _pImpl->submit(bufferSlot);
+}
+
+NeuralNetworkRuntime::Ticket NeuralNetworkRuntime::submit(int bufferSlot, int device)
+{
+    return _pImpl->submit(bufferSlot, device);
+}
+
+std::vector<NeuralNetworkRuntime::Ticket> NeuralNetworkRuntime::submitBatch(const std::vector<int> &bufferSlots)
+{
+    return _pImpl->submitBatch(bufferSlots);
+}
+
+std::vector<std::vector<float>> NeuralNetworkRuntime::wait(Ticket ticket)
+{
+    return _pImpl->wait(ticket);
+}
+
+void NeuralNetworkRuntime::wait(Ticket ticket, std::vector<std::vector<float>> &results)
+{
+    _pImpl->wait(ticket, results);
+}
+
+int NeuralNetworkRuntime::getOutputCount() const
+{
+    return _pImpl->getOutputCount();
+}
+
+NeuralNetworkRuntime::OutputTensor NeuralNetworkRuntime::mapOutput(Ticket ticket, int outputIndex)
+{
+    return _pImpl->mapOutput(ticket, outputIndex);
+}
+
+void NeuralNetworkRuntime::waitFinished(Ticket ticket)
+{
+    _pImpl->waitFinished(ticket);
+}
+
+void NeuralNetworkRuntime::releaseOutputs(Ticket ticket)
+{
+    _pImpl->releaseOutputs(ticket);
+}
+
+NeuralNetworkRuntime::Stats NeuralNetworkRuntime::stats() const
+{
+    return _pImpl->stats();
+}
+
+void NeuralNetworkRuntime::stats(Stats &stats) const
+{
+    _pImpl->getStats(stats);
+}
+
+void NeuralNetworkRuntime::resetStats()
+{
+    _pImpl->resetStats();
+}
+
 void NeuralNetworkRuntime::destroy()
 {
     _pImpl->destroy();
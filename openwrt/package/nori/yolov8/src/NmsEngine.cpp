@@ -0,0 +1,245 @@
+#include "NmsEngine.hpp"
+
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NMS_ENGINE_NEON 1
+#endif
+
+void NmsEngine::clear()
+{
+    x1s.clear();
+    y1s.clear();
+    x2s.clear();
+    y2s.clear();
+    scores.clear();
+    classIds.clear();
+}
+
+void NmsEngine::add(const cv::Rect2d &box, float score, int classId)
+{
+    x1s.push_back(box.x);
+    y1s.push_back(box.y);
+    x2s.push_back(box.x + box.width);
+    y2s.push_back(box.y + box.height);
+    scores.push_back(score);
+    classIds.push_back(classId);
+}
+
+size_t NmsEngine::getCount() const
+{
+    return scores.size();
+}
+
+void NmsEngine::sort()
+{
+    int count = scores.size();
+
+    order.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        order[i] = i;
+    }
+
+    // ties in the order of add(), like a stable sort but without its buffer
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+    });
+
+    sortedX1s.resize(count);
+    sortedY1s.resize(count);
+    sortedX2s.resize(count);
+    sortedY2s.resize(count);
+    sortedAreas.resize(count);
+    sortedClassIds.resize(count);
+
+    for (int i = 0; i < count; i++)
+    {
+        int index = order[i];
+
+        sortedX1s[i] = x1s[index];
+        sortedY1s[i] = y1s[index];
+        sortedX2s[i] = x2s[index];
+        sortedY2s[i] = y2s[index];
+        sortedAreas[i] = (x2s[index] - x1s[index]) * (y2s[index] - y1s[index]);
+        sortedClassIds[i] = classIds[index];
+    }
+}
+
+bool NmsEngine::isOverlapping(int a, int b, float iouThreshold) const
+{
+    float width = std::max(std::min(sortedX2s[a], sortedX2s[b]) - std::max(sortedX1s[a], sortedX1s[b]), 0.0f);
+    float height = std::max(std::min(sortedY2s[a], sortedY2s[b]) - std::max(sortedY1s[a], sortedY1s[b]), 0.0f);
+    float intersection = width * height;
+
+    // intersection / (areaA + areaB - intersection) > iouThreshold without the division
+    return intersection * (1.0f + iouThreshold) > iouThreshold * (sortedAreas[a] + sortedAreas[b]);
+}
+
+void NmsEngine::runGreedy(const Config &config, std::vector<int> &kept)
+{
+    int count = order.size();
+
+    keptPositions.clear();
+
+    for (int i = 0; i < count; i++)
+    {
+        bool isSuppressed = false;
+
+        for (int k : keptPositions)
+        {
+            if ((!config.isClassAware || sortedClassIds[k] == sortedClassIds[i]) && isOverlapping(k, i, config.iouThreshold))
+            {
+                isSuppressed = true;
+                break;
+            }
+        }
+
+        if (isSuppressed)
+        {
+            continue;
+        }
+
+        keptPositions.push_back(i);
+        kept.push_back(order[i]);
+
+        if (kept.size() == config.maxDetections)
+        {
+            return;
+        }
+    }
+}
+
+void NmsEngine::suppressOverlapping(int i, const Config &config)
+{
+    int count = order.size();
+    uint64_t *mask = suppressedMask.data();
+    int j = i + 1;
+
+#ifdef NMS_ENGINE_NEON
+    // up to a multiple of 4, so that the 4 bits of a step never straddle two words
+    for (; j < count && (j & 3) != 0; j++)
+    {
+        if ((!config.isClassAware || sortedClassIds[i] == sortedClassIds[j]) && isOverlapping(i, j, config.iouThreshold))
+        {
+            mask[j >> 6] |= (uint64_t)1 << (j & 63);
+        }
+    }
+
+    const float32x4_t x1 = vdupq_n_f32(sortedX1s[i]);
+    const float32x4_t y1 = vdupq_n_f32(sortedY1s[i]);
+    const float32x4_t x2 = vdupq_n_f32(sortedX2s[i]);
+    const float32x4_t y2 = vdupq_n_f32(sortedY2s[i]);
+    const float32x4_t area = vdupq_n_f32(sortedAreas[i]);
+    const int32x4_t classId = vdupq_n_s32(sortedClassIds[i]);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t threshold = vdupq_n_f32(config.iouThreshold);
+    const float32x4_t thresholdPlusOne = vdupq_n_f32(1.0f + config.iouThreshold);
+    const uint32x4_t classMask = vdupq_n_u32(config.isClassAware ? 0 : UINT32_MAX);
+    const uint32_t laneBitValues[4] = {1, 2, 4, 8};
+    const uint32x4_t laneBits = vld1q_u32(laneBitValues);
+
+    for (; j + 4 <= count; j += 4)
+    {
+        // four boxes already suppressed by an earlier kept box need no overlap, a whole word of them neither
+        if (mask[j >> 6] == UINT64_MAX)
+        {
+            j = (j | 63) - 3;
+            continue;
+        }
+        if (((mask[j >> 6] >> (j & 63)) & 0xf) == 0xf)
+        {
+            continue;
+        }
+
+        float32x4_t width = vsubq_f32(vminq_f32(x2, vld1q_f32(&sortedX2s[j])), vmaxq_f32(x1, vld1q_f32(&sortedX1s[j])));
+        float32x4_t height = vsubq_f32(vminq_f32(y2, vld1q_f32(&sortedY2s[j])), vmaxq_f32(y1, vld1q_f32(&sortedY1s[j])));
+        float32x4_t intersection = vmulq_f32(vmaxq_f32(width, zero), vmaxq_f32(height, zero));
+        float32x4_t areas = vaddq_f32(area, vld1q_f32(&sortedAreas[j]));
+
+        uint32x4_t overlaps = vcgtq_f32(vmulq_f32(intersection, thresholdPlusOne), vmulq_f32(threshold, areas));
+        uint32x4_t isSameClass = vorrq_u32(vceqq_s32(classId, vld1q_s32(&sortedClassIds[j])), classMask);
+        uint32x4_t bits = vandq_u32(vandq_u32(overlaps, isSameClass), laneBits);
+
+        uint32x2_t sum = vpadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+        sum = vpadd_u32(sum, sum);
+
+        mask[j >> 6] |= (uint64_t)vget_lane_u32(sum, 0) << (j & 63);
+    }
+#endif
+
+    for (; j < count; j++)
+    {
+        // a box already suppressed by an earlier kept box needs no overlap, like the break of runGreedy()
+        if (mask[j >> 6] == UINT64_MAX)
+        {
+            j |= 63;
+            continue;
+        }
+        if ((mask[j >> 6] >> (j & 63)) & 1)
+        {
+            continue;
+        }
+
+        if ((!config.isClassAware || sortedClassIds[i] == sortedClassIds[j]) && isOverlapping(i, j, config.iouThreshold))
+        {
+            mask[j >> 6] |= (uint64_t)1 << (j & 63);
+        }
+    }
+}
+
+void NmsEngine::runBitmask(const Config &config, std::vector<int> &kept)
+{
+    int count = order.size();
+
+    suppressedMask.assign((count + 63) / 64, 0);
+
+    for (int i = 0; i < count; i++)
+    {
+        if ((suppressedMask[i >> 6] >> (i & 63)) & 1)
+        {
+            continue;
+        }
+
+        kept.push_back(order[i]);
+
+        if (kept.size() == config.maxDetections)
+        {
+            return;
+        }
+
+        suppressOverlapping(i, config);
+    }
+}
+
+void NmsEngine::run(const Config &config, std::vector<int> &kept)
+{
+    kept.clear();
+
+    if (scores.empty())
+    {
+        return;
+    }
+
+    sort();
+
+    // the scalar rows cost more than the compares of runGreedy(), which stop at the first overlapping kept box
+    if (isNeonEnabled() && config.bitmaskMinCount > 0 && scores.size() >= config.bitmaskMinCount)
+    {
+        runBitmask(config, kept);
+    }
+    else
+    {
+        runGreedy(config, kept);
+    }
+}
+
+bool NmsEngine::isNeonEnabled()
+{
+#ifdef NMS_ENGINE_NEON
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,140 @@
+#include "NpuContext.hpp"
+
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include <stdio.h>
+#include <memory.h>
+
+#include "VipStatusException.hpp"
+
+namespace
+{
+    std::mutex contextMutex;
+
+    int referenceCount = 0;
+    unsigned int initializedMemSize = 0;
+
+    vip_buffer memoryPool = nullptr;
+    unsigned int memoryPoolSize = 0;
+    int memoryPoolReferenceCount = 0;
+}
+
+void NpuContext::acquire(unsigned int memSize)
+{
+    std::lock_guard<std::mutex> lock(contextMutex);
+
+    if (referenceCount == 0)
+    {
+        vip_status_e status = vip_init(memSize);
+        CHECK_VIP_STATUS_WITH_MSG(status, "vip_init of %u bytes failed", memSize);
+
+        initializedMemSize = memSize;
+    }
+    else if (memSize > initializedMemSize)
+    {
+        std::cout << "NpuContext already initialized with " << initializedMemSize
+                  << " bytes, requested " << memSize << " bytes is ignored" << std::endl;
+    }
+
+    referenceCount++;
+}
+
+void NpuContext::release()
+{
+    std::lock_guard<std::mutex> lock(contextMutex);
+
+    if (referenceCount == 0)
+    {
+        return;
+    }
+
+    referenceCount--;
+
+    if (referenceCount == 0)
+    {
+        if (memoryPool != nullptr)
+        {
+            vip_destroy_buffer(memoryPool);
+            memoryPool = nullptr;
+            memoryPoolSize = 0;
+            memoryPoolReferenceCount = 0;
+        }
+
+        vip_destroy();
+
+        initializedMemSize = 0;
+    }
+}
+
+bool NpuContext::isInitialized()
+{
+    std::lock_guard<std::mutex> lock(contextMutex);
+
+    return referenceCount > 0;
+}
+
+unsigned int NpuContext::getMemSize()
+{
+    std::lock_guard<std::mutex> lock(contextMutex);
+
+    return initializedMemSize;
+}
+
+vip_buffer NpuContext::acquireMemoryPool(unsigned int size)
+{
+    std::lock_guard<std::mutex> lock(contextMutex);
+
+    if (referenceCount == 0)
+    {
+        throw std::logic_error("NpuContext must be acquired before its memory pool!");
+    }
+
+    if (memoryPool == nullptr)
+    {
+        vip_buffer_create_params_t bufferCreateParams;
+        memset(&bufferCreateParams, 0, sizeof(vip_buffer_create_params_t));
+        bufferCreateParams.num_of_dims = 1;
+        bufferCreateParams.sizes[0] = size;
+        bufferCreateParams.data_format = VIP_BUFFER_FORMAT_UINT8;
+        bufferCreateParams.quant_format = VIP_BUFFER_QUANTIZE_NONE;
+        bufferCreateParams.memory_type = VIP_BUFFER_MEMORY_TYPE_DEFAULT;
+
+        vip_status_e status = vip_create_buffer(&bufferCreateParams, sizeof(bufferCreateParams), &memoryPool);
+        CHECK_VIP_STATUS_WITH_MSG(status, "Can't create shared memory pool of %u bytes", size);
+
+        memoryPoolSize = size;
+
+        std::cout << "NpuContext shared memory pool: " << memoryPoolSize << " bytes" << std::endl;
+    }
+    else if (size > memoryPoolSize)
+    {
+        throw std::runtime_error("Shared memory pool of " + std::to_string(memoryPoolSize) + " bytes is smaller than the requested "
+                                 + std::to_string(size) + " bytes, create the network with the largest pool first!");
+    }
+
+    memoryPoolReferenceCount++;
+
+    return memoryPool;
+}
+
+void NpuContext::releaseMemoryPool()
+{
+    std::lock_guard<std::mutex> lock(contextMutex);
+
+    if (memoryPoolReferenceCount == 0)
+    {
+        return;
+    }
+
+    memoryPoolReferenceCount--;
+
+    if (memoryPoolReferenceCount == 0)
+    {
+        vip_destroy_buffer(memoryPool);
+        memoryPool = nullptr;
+        memoryPoolSize = 0;
+    }
+}
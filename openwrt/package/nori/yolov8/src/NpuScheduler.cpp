@@ -0,0 +1,443 @@
+#include "NpuScheduler.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdexcept>
+
+#include <stdint.h>
+#include <time.h>
+
+class NpuScheduler::Impl
+{
+private:
+    struct Request
+    {
+        int bufferSlot;
+        CompletionCallback onCompleted;
+        // get_perf_count() of the request, the deadline is 0 if none
+        uint64_t requestTime;
+        uint64_t deadline;
+    };
+
+    struct Model
+    {
+        ModelConfig config;
+        std::unique_ptr<NeuralNetworkRuntime> nnRuntime;
+        std::deque<Request> requests;
+        // 0 for best effort
+        uint64_t period = 0;
+        // get_perf_count() at which the rate target wants the next submit
+        uint64_t nextDueTime = 0;
+
+        LatencyHistogram queueingDelay;
+        LatencyHistogram serviceTime;
+        std::atomic<unsigned long long> completedCount{0};
+        std::atomic<unsigned long long> droppedCount{0};
+        std::atomic<unsigned long long> failedCount{0};
+        std::atomic<unsigned long long> deadlineMissCount{0};
+    };
+
+    NpuScheduler::Config config;
+
+    // unique_ptr, the histograms can't move
+    std::vector<std::unique_ptr<Model>> models;
+
+    mutable std::mutex mutex;
+    std::condition_variable requestCondVar;
+    // every thread has one request on the NPU at a time
+    std::vector<std::thread> workerThreads;
+    // from stop() until the next start(), requests then fail at once
+    bool isStopped = false;
+
+    static uint64_t get_perf_count()
+    {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t)((uint64_t)ts.tv_nsec + (uint64_t)ts.tv_sec * 1000000000);
+    }
+
+    Model &getModel(ModelId modelId) const
+    {
+        if (modelId < 0 || modelId >= (int)models.size())
+        {
+            throw std::out_of_range("Invalid model id: " + std::to_string(modelId));
+        }
+
+        return *models[modelId];
+    }
+
+    // true if request a of model a runs before request b of model b
+    static bool isMoreUrgent(const Model &a, const Request &requestA, const Model &b, const Request &requestB, uint64_t now)
+    {
+        bool isADue = a.period != 0 && now >= a.nextDueTime;
+        bool isBDue = b.period != 0 && now >= b.nextDueTime;
+        if (isADue != isBDue)
+        {
+            return isADue;
+        }
+
+        if (a.config.priority != b.config.priority)
+        {
+            return a.config.priority > b.config.priority;
+        }
+
+        if (requestA.deadline != requestB.deadline)
+        {
+            // no deadline goes last
+            return requestB.deadline == 0 || (requestA.deadline != 0 && requestA.deadline < requestB.deadline);
+        }
+
+        return requestA.requestTime < requestB.requestTime;
+    }
+
+    // Returns the model of the most urgent request, -1 if none is queued.
+    int selectModel(uint64_t now) const
+    {
+        int selectedModel = -1;
+
+        for (int i = 0; i < (int)models.size(); i++)
+        {
+            if (models[i]->requests.empty())
+            {
+                continue;
+            }
+
+            if (selectedModel < 0 ||
+                isMoreUrgent(*models[i], models[i]->requests.front(), *models[selectedModel], models[selectedModel]->requests.front(), now))
+            {
+                selectedModel = i;
+            }
+        }
+
+        return selectedModel;
+    }
+
+    void run(Model &model, const Request &request, int device)
+    {
+        NeuralNetworkRuntime::Ticket ticket = 0;
+
+        try
+        {
+            uint64_t submitTime = get_perf_count();
+            model.queueingDelay.record((submitTime - request.requestTime) / 1000);
+
+            int deviceCount = model.nnRuntime->getDeviceCount();
+            // a runtime which isn't created yet throws
+            ticket = deviceCount > 0 ? model.nnRuntime->submit(request.bufferSlot, device % deviceCount)
+                                     : model.nnRuntime->submit(request.bufferSlot);
+
+            // the thread takes the next request once this one is done, a later urgent request doesn't queue up in the driver
+            model.nnRuntime->waitFinished(ticket);
+
+            uint64_t finishedTime = get_perf_count();
+            model.serviceTime.record((finishedTime - submitTime) / 1000);
+
+            if (request.deadline != 0 && finishedTime > request.deadline)
+            {
+                model.deadlineMissCount.fetch_add(1);
+            }
+        }
+        catch (...)
+        {
+            model.failedCount.fetch_add(1);
+            complete(request, ticket, std::current_exception());
+            return;
+        }
+
+        model.completedCount.fetch_add(1);
+        complete(request, ticket, nullptr);
+    }
+
+    // Thread i submits to device i, so the runtimes, which only know about their own inferences, don't pile up on one.
+    void work(int device)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (!isStopped)
+        {
+            uint64_t now = get_perf_count();
+            int modelIndex = selectModel(now);
+
+            if (modelIndex < 0)
+            {
+                requestCondVar.wait(lock);
+                continue;
+            }
+
+            Model &model = *models[modelIndex];
+            Request request = model.requests.front();
+            model.requests.pop_front();
+
+            if (model.period != 0)
+            {
+                // a model which fell far behind doesn't get a burst to catch up
+                model.nextDueTime = (now >= model.nextDueTime + model.period ? now : model.nextDueTime) + model.period;
+            }
+
+            lock.unlock();
+
+            run(model, request, device);
+
+            lock.lock();
+        }
+    }
+
+    // a throwing callback must not take the scheduler thread down
+    static void complete(const Request &request, NeuralNetworkRuntime::Ticket ticket, std::exception_ptr error)
+    {
+        try
+        {
+            request.onCompleted(ticket, error);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "NpuScheduler completion: " << e.what() << std::endl;
+        }
+    }
+
+    static void completeWithError(const Request &request, const char *message)
+    {
+        complete(request, 0, std::make_exception_ptr(std::runtime_error(message)));
+    }
+
+public:
+    explicit Impl(const NpuScheduler::Config &config)
+        : config(config)
+    {
+    }
+
+    ModelId addModel(const ModelConfig &modelConfig)
+    {
+        if (!workerThreads.empty())
+        {
+            throw std::logic_error("Can't add a model while the scheduler is running!");
+        }
+
+        if (modelConfig.priority > 255)
+        {
+            throw std::invalid_argument("Model priority " + std::to_string(modelConfig.priority) + " is above 255!");
+        }
+
+        if (modelConfig.targetFps < 0.0f)
+        {
+            throw std::invalid_argument("Model targetFps can't be negative!");
+        }
+
+        std::unique_ptr<Model> model(new Model());
+        model->config = modelConfig;
+        model->config.nnRuntimeConfig.priority = modelConfig.priority;
+        if (model->config.maxQueueDepth == 0)
+        {
+            model->config.maxQueueDepth = 1;
+        }
+        if (modelConfig.targetFps > 0.0f)
+        {
+            model->period = (uint64_t)(1000000000.0 / modelConfig.targetFps);
+        }
+
+        model->nnRuntime.reset(new NeuralNetworkRuntime(model->config.nnRuntimeConfig));
+
+        models.push_back(std::move(model));
+
+        return models.size() - 1;
+    }
+
+    NeuralNetworkRuntime &getRuntime(ModelId modelId)
+    {
+        return *getModel(modelId).nnRuntime;
+    }
+
+    void start()
+    {
+        if (!workerThreads.empty())
+        {
+            return;
+        }
+
+        unsigned int inFlightCount = config.maxInFlightCount;
+        if (inFlightCount == 0)
+        {
+            // the runtimes share the devices, one request for each
+            for (auto &model : models)
+            {
+                inFlightCount = std::max(inFlightCount, (unsigned int)model->nnRuntime->getDeviceCount());
+            }
+            inFlightCount = std::max(inFlightCount, 1u);
+        }
+
+        uint64_t now = get_perf_count();
+        for (auto &model : models)
+        {
+            model->nextDueTime = now;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isStopped = false;
+        }
+        for (unsigned int i = 0; i < inFlightCount; i++)
+        {
+            workerThreads.push_back(std::thread(&Impl::work, this, i));
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isStopped = true;
+        }
+        requestCondVar.notify_all();
+
+        for (auto &workerThread : workerThreads)
+        {
+            workerThread.join();
+        }
+        workerThreads.clear();
+
+        // also those queued before a start() which never came
+        std::vector<Request> pendingRequests;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &model : models)
+            {
+                pendingRequests.insert(pendingRequests.end(), model->requests.begin(), model->requests.end());
+                model->requests.clear();
+            }
+        }
+
+        for (auto &request : pendingRequests)
+        {
+            completeWithError(request, "NpuScheduler stopped");
+        }
+    }
+
+    void request(ModelId modelId, int bufferSlot, const CompletionCallback &onCompleted)
+    {
+        Model &model = getModel(modelId);
+
+        uint64_t now = get_perf_count();
+        Request request = {
+            .bufferSlot = bufferSlot,
+            .onCompleted = onCompleted,
+            .requestTime = now,
+            .deadline = model.config.deadlineMs != 0 ? now + (uint64_t)model.config.deadlineMs * 1000000 : 0
+        };
+
+        Request droppedRequest = {};
+        bool isDropped = false;
+        bool isRefused = false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (isStopped)
+            {
+                isRefused = true;
+            }
+            else
+            {
+                if (model.requests.size() >= model.config.maxQueueDepth)
+                {
+                    droppedRequest = model.requests.front();
+                    model.requests.pop_front();
+                    isDropped = true;
+                }
+
+                model.requests.push_back(request);
+            }
+        }
+
+        if (isRefused)
+        {
+            // outside the lock like a dropped request, no worker would ever run it
+            completeWithError(request, "NpuScheduler stopped");
+            return;
+        }
+
+        requestCondVar.notify_all();
+
+        if (isDropped)
+        {
+            model.droppedCount.fetch_add(1);
+            // outside the lock, the callback may request again
+            completeWithError(droppedRequest, "NpuScheduler dropped a request of a full queue");
+        }
+    }
+
+    std::vector<ModelStats> stats() const
+    {
+        std::vector<ModelStats> modelStats;
+
+        for (auto &model : models)
+        {
+            ModelStats stats;
+            stats.name = model->config.name;
+            stats.queueingDelay = model->queueingDelay.getPercentiles();
+            stats.serviceTime = model->serviceTime.getPercentiles();
+            stats.completedCount = model->completedCount.load();
+            stats.droppedCount = model->droppedCount.load();
+            stats.failedCount = model->failedCount.load();
+            stats.deadlineMissCount = model->deadlineMissCount.load();
+            modelStats.push_back(stats);
+        }
+
+        return modelStats;
+    }
+
+    ~Impl()
+    {
+        stop();
+    }
+};
+
+NpuScheduler::NpuScheduler()
+    : _pImpl(new Impl(Config()))
+{
+
+}
+
+NpuScheduler::NpuScheduler(const Config &config)
+    : _pImpl(new Impl(config))
+{
+
+}
+
+NpuScheduler::~NpuScheduler() = default;
+
+NpuScheduler::ModelId NpuScheduler::addModel(const ModelConfig &modelConfig)
+{
+    return _pImpl->addModel(modelConfig);
+}
+
+NeuralNetworkRuntime &NpuScheduler::getRuntime(ModelId modelId)
+{
+    return _pImpl->getRuntime(modelId);
+}
+
+void NpuScheduler::start()
+{
+    _pImpl->start();
+}
+
+void NpuScheduler::stop()
+{
+    _pImpl->stop();
+}
+
+void NpuScheduler::request(ModelId modelId, int bufferSlot, const CompletionCallback &onCompleted)
+{
+    _pImpl->request(modelId, bufferSlot, onCompleted);
+}
+
+std::vector<NpuScheduler::ModelStats> NpuScheduler::stats() const
+{
+    return _pImpl->stats();
+}
@@ -0,0 +1,368 @@
+#include "ResizeEngine.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RESIZE_ENGINE_NEON 1
+#endif
+
+ResizeEngine::ResizeEngine(const Config &config)
+    : config(config)
+{
+    if (config.srcSize.width <= 0 || config.srcSize.height <= 0 || config.dstSize.width <= 0 || config.dstSize.height <= 0)
+    {
+        throw std::invalid_argument("Invalid resize size");
+    }
+
+    if (config.channels <= 0 || config.channels > 4)
+    {
+        throw std::invalid_argument("Unsupported channel count: " + std::to_string(config.channels));
+    }
+
+    xTaps = createTaps(config.srcSize.width, config.dstSize.width, config.interpolation);
+    yTaps = createTaps(config.srcSize.height, config.dstSize.height, config.interpolation);
+
+#ifdef RESIZE_ENGINE_NEON
+    if (config.channels == 3)
+    {
+        int groupCount = config.dstSize.width / LANE_COUNT;
+        xTaps.laneWeights.resize(groupCount * xTaps.tapCount * LANE_COUNT);
+
+        for (int group = 0; group < groupCount; group++)
+        {
+            for (int t = 0; t < xTaps.tapCount; t++)
+            {
+                for (int lane = 0; lane < LANE_COUNT; lane++)
+                {
+                    xTaps.laneWeights[(group * xTaps.tapCount + t) * LANE_COUNT + lane] =
+                        xTaps.weights[(group * LANE_COUNT + lane) * xTaps.tapCount + t];
+                }
+            }
+        }
+    }
+#endif
+
+    if (yTaps.tapCount > MAX_TAP_COUNT)
+    {
+        throw std::invalid_argument("Resize factor too large: " + std::to_string(yTaps.tapCount) + " rows per output row");
+    }
+
+    rowBuffers.resize(yTaps.tapCount);
+    for (auto &rowBuffer : rowBuffers)
+    {
+        rowBuffer.resize(config.dstSize.width * config.channels);
+    }
+    bufferedRows.resize(yTaps.tapCount);
+
+    startFrame();
+}
+
+ResizeEngine::Taps ResizeEngine::createTaps(int srcSize, int dstSize, Interpolation interpolation)
+{
+    double scale = (double)srcSize / dstSize;
+
+    // source index and real weight of every tap of every output pixel
+    std::vector<std::vector<std::pair<int, double>>> pixels(dstSize);
+
+    for (int d = 0; d < dstSize; d++)
+    {
+        auto &pixel = pixels[d];
+
+        if (interpolation == INTERPOLATION_AREA && scale > 1.0)
+        {
+            double begin = d * scale;
+            double end = std::min((d + 1) * scale, (double)srcSize);
+
+            for (int s = (int)std::floor(begin); s < end; s++)
+            {
+                double overlap = std::min(end, s + 1.0) - std::max(begin, (double)s);
+                if (overlap > 1e-9)
+                {
+                    pixel.emplace_back(s, overlap / scale);
+                }
+            }
+        }
+        else
+        {
+            double src = (d + 0.5) * scale - 0.5;
+            int left = (int)std::floor(src);
+            double weight = src - left;
+
+            if (left < 0)
+            {
+                left = 0;
+                weight = 0;
+            }
+            if (left >= srcSize - 1)
+            {
+                left = srcSize - 1;
+                weight = 0;
+            }
+
+            pixel.emplace_back(left, 1.0 - weight);
+            if (weight > 0)
+            {
+                pixel.emplace_back(left + 1, weight);
+            }
+        }
+    }
+
+    Taps taps;
+    for (auto &pixel : pixels)
+    {
+        taps.tapCount = std::max(taps.tapCount, (int)pixel.size());
+    }
+
+    taps.starts.resize(dstSize);
+    taps.weights.assign(dstSize * taps.tapCount, 0);
+
+    for (int d = 0; d < dstSize; d++)
+    {
+        auto &pixel = pixels[d];
+        int start = std::min(pixel.front().first, srcSize - taps.tapCount);
+        uint16_t *weights = &taps.weights[d * taps.tapCount];
+
+        int sum = 0;
+        int largest = 0;
+        for (auto &tap : pixel)
+        {
+            int index = tap.first - start;
+            weights[index] = (uint16_t)std::lround(tap.second * WEIGHT_ONE);
+            sum += weights[index];
+
+            if (weights[index] > weights[largest])
+            {
+                largest = index;
+            }
+        }
+
+        // exactly one in fixed point, so a plain area stays plain
+        weights[largest] += WEIGHT_ONE - sum;
+        taps.starts[d] = start;
+    }
+
+    return taps;
+}
+
+const ResizeEngine::Config &ResizeEngine::getConfig() const
+{
+    return config;
+}
+
+void ResizeEngine::startFrame()
+{
+    std::fill(bufferedRows.begin(), bufferedRows.end(), -1);
+}
+
+void ResizeEngine::resizeRowHorizontally(const uint8_t *src, uint16_t *dst) const
+{
+    int width = config.dstSize.width;
+    int channels = config.channels;
+    int tapCount = xTaps.tapCount;
+    const int *starts = xTaps.starts.data();
+    int x = 0;
+
+#ifdef RESIZE_ENGINE_NEON
+    if (channels == 3)
+    {
+        // Every tap gathers one source pixel per lane, split into its channels by vld3_lane. A weight can be 256,
+        // so the pixels are widened and multiplied in 16 bits, which holds the sum as the weights add up to 256.
+        const uint16_t *laneWeights = xTaps.laneWeights.data();
+
+        for (; x + LANE_COUNT <= width; x += LANE_COUNT)
+        {
+            const int *lanes = starts + x;
+            uint16x8x3_t sum;
+            sum.val[0] = vdupq_n_u16(0);
+            sum.val[1] = vdupq_n_u16(0);
+            sum.val[2] = vdupq_n_u16(0);
+
+            for (int t = 0; t < tapCount; t++, laneWeights += LANE_COUNT)
+            {
+                const uint8_t *tapSrc = src + t * 3;
+                uint8x8x3_t pixels;
+                pixels.val[0] = vdup_n_u8(0);
+                pixels.val[1] = vdup_n_u8(0);
+                pixels.val[2] = vdup_n_u8(0);
+
+                pixels = vld3_lane_u8(tapSrc + lanes[0] * 3, pixels, 0);
+                pixels = vld3_lane_u8(tapSrc + lanes[1] * 3, pixels, 1);
+                pixels = vld3_lane_u8(tapSrc + lanes[2] * 3, pixels, 2);
+                pixels = vld3_lane_u8(tapSrc + lanes[3] * 3, pixels, 3);
+                pixels = vld3_lane_u8(tapSrc + lanes[4] * 3, pixels, 4);
+                pixels = vld3_lane_u8(tapSrc + lanes[5] * 3, pixels, 5);
+                pixels = vld3_lane_u8(tapSrc + lanes[6] * 3, pixels, 6);
+                pixels = vld3_lane_u8(tapSrc + lanes[7] * 3, pixels, 7);
+
+                uint16x8_t weight = vld1q_u16(laneWeights);
+                sum.val[0] = vmlaq_u16(sum.val[0], vmovl_u8(pixels.val[0]), weight);
+                sum.val[1] = vmlaq_u16(sum.val[1], vmovl_u8(pixels.val[1]), weight);
+                sum.val[2] = vmlaq_u16(sum.val[2], vmovl_u8(pixels.val[2]), weight);
+            }
+
+            vst3q_u16(dst + x * 3, sum);
+        }
+    }
+#endif
+
+    const uint16_t *weights = xTaps.weights.data() + x * tapCount;
+    dst += x * channels;
+
+    if (channels == 3 && tapCount == 2)
+    {
+        for (; x < width; x++, dst += 3, weights += 2)
+        {
+            const uint8_t *left = src + starts[x] * 3;
+            uint16_t leftWeight = weights[0];
+            uint16_t rightWeight = weights[1];
+
+            dst[0] = left[0] * leftWeight + left[3] * rightWeight;
+            dst[1] = left[1] * leftWeight + left[4] * rightWeight;
+            dst[2] = left[2] * leftWeight + left[5] * rightWeight;
+        }
+        return;
+    }
+
+    if (channels == 3)
+    {
+        for (; x < width; x++, dst += 3, weights += tapCount)
+        {
+            const uint8_t *first = src + starts[x] * 3;
+            uint32_t blue = 0;
+            uint32_t green = 0;
+            uint32_t red = 0;
+
+            for (int t = 0; t < tapCount; t++, first += 3)
+            {
+                blue += first[0] * weights[t];
+                green += first[1] * weights[t];
+                red += first[2] * weights[t];
+            }
+
+            dst[0] = blue;
+            dst[1] = green;
+            dst[2] = red;
+        }
+        return;
+    }
+
+    for (; x < width; x++, dst += channels, weights += tapCount)
+    {
+        const uint8_t *first = src + starts[x] * channels;
+
+        for (int c = 0; c < channels; c++)
+        {
+            uint32_t sum = 0;
+            for (int t = 0; t < tapCount; t++)
+            {
+                sum += first[t * channels + c] * weights[t];
+            }
+            dst[c] = sum;
+        }
+    }
+}
+
+const uint16_t *ResizeEngine::getResizedRow(const cv::Mat &src, int srcRow)
+{
+    // the rows of one output row are consecutive, so they never share a buffer
+    int index = srcRow % yTaps.tapCount;
+
+    if (bufferedRows[index] != srcRow)
+    {
+        resizeRowHorizontally(src.ptr<uint8_t>(srcRow), rowBuffers[index].data());
+        bufferedRows[index] = srcRow;
+    }
+
+    return rowBuffers[index].data();
+}
+
+void ResizeEngine::resizeRow(const cv::Mat &src, int dstRow, uint8_t *dst)
+{
+    int tapCount = yTaps.tapCount;
+    int start = yTaps.starts[dstRow];
+    const uint16_t *weights = &yTaps.weights[dstRow * tapCount];
+    int count = config.dstSize.width * config.channels;
+
+    const uint16_t *rows[MAX_TAP_COUNT];
+    for (int t = 0; t < tapCount; t++)
+    {
+        rows[t] = getResizedRow(src, start + t);
+    }
+
+    int i = 0;
+
+#ifdef RESIZE_ENGINE_NEON
+    for (; i + 8 <= count; i += 8)
+    {
+        uint32x4_t low = vdupq_n_u32(0);
+        uint32x4_t high = vdupq_n_u32(0);
+
+        for (int t = 0; t < tapCount; t++)
+        {
+            uint16x8_t value = vld1q_u16(rows[t] + i);
+
+            low = vmlal_n_u16(low, vget_low_u16(value), weights[t]);
+            high = vmlal_n_u16(high, vget_high_u16(value), weights[t]);
+        }
+
+        vst1_u8(dst + i, vmovn_u16(vcombine_u16(vrshrn_n_u32(low, 2 * WEIGHT_BITS), vrshrn_n_u32(high, 2 * WEIGHT_BITS))));
+    }
+#endif
+
+    // bilinear, two rows with their weights as constants, which the compiler can vectorise
+    if (tapCount == 2)
+    {
+        const uint16_t *top = rows[0];
+        const uint16_t *bottom = rows[1];
+        uint32_t topWeight = weights[0];
+        uint32_t bottomWeight = weights[1];
+
+        for (; i < count; i++)
+        {
+            dst[i] = (top[i] * topWeight + bottom[i] * bottomWeight + (1 << (2 * WEIGHT_BITS - 1))) >> (2 * WEIGHT_BITS);
+        }
+        return;
+    }
+
+    for (; i < count; i++)
+    {
+        uint32_t sum = 1 << (2 * WEIGHT_BITS - 1);
+        for (int t = 0; t < tapCount; t++)
+        {
+            sum += rows[t][i] * weights[t];
+        }
+        dst[i] = sum >> (2 * WEIGHT_BITS);
+    }
+}
+
+void ResizeEngine::run(const cv::Mat &src, cv::Mat &dst)
+{
+    if (src.type() != CV_8UC(config.channels) || src.size() != config.srcSize)
+    {
+        throw std::invalid_argument("Image doesn't match the resize, must be 8 bits per pixel, " + std::to_string(config.channels) +
+                                    " channels and " + std::to_string(config.srcSize.width) + "x" + std::to_string(config.srcSize.height));
+    }
+
+    dst.create(config.dstSize, src.type());
+
+    startFrame();
+
+    for (int y = 0; y < config.dstSize.height; y++)
+    {
+        resizeRow(src, y, dst.ptr<uint8_t>(y));
+    }
+}
+
+bool ResizeEngine::isNeonEnabled()
+{
+#ifdef RESIZE_ENGINE_NEON
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,222 @@
+#include "TensorRecording.hpp"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const char MAGIC[8] = {'N', 'N', 'R', 'E', 'C', 'O', 'R', 'D'};
+}
+
+TensorRecording::Writer::Writer(const std::string &filePath, const std::vector<Tensor> &inputs, const std::vector<Tensor> &outputs, bool isRecordingInputs)
+    : file(nullptr), inputCount(inputs.size())
+{
+    tensors = inputs;
+    tensors.insert(tensors.end(), outputs.begin(), outputs.end());
+
+    uint32_t offset = align(sizeof(Frame));
+    for (size_t i = 0; i < tensors.size(); i++)
+    {
+        if (i < inputCount && !isRecordingInputs)
+        {
+            tensors[i].offset = 0;
+            continue;
+        }
+
+        tensors[i].offset = offset;
+        offset += align(tensors[i].size);
+    }
+    frameSize = offset;
+
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.inputCount = inputs.size();
+    header.outputCount = outputs.size();
+    header.isRecordingInputs = isRecordingInputs ? 1 : 0;
+    header.frameOffset = align(sizeof(Header) + sizeof(Tensor) * tensors.size());
+    header.frameSize = frameSize;
+
+    file = fopen(filePath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        throw std::runtime_error("Can't create recording " + filePath);
+    }
+
+    std::vector<char> headerBuffer(header.frameOffset, 0);
+    memcpy(headerBuffer.data(), &header, sizeof(Header));
+    memcpy(headerBuffer.data() + sizeof(Header), tensors.data(), sizeof(Tensor) * tensors.size());
+
+    if (fwrite(headerBuffer.data(), headerBuffer.size(), 1, file) != 1)
+    {
+        fclose(file);
+        throw std::runtime_error("Can't write recording " + filePath);
+    }
+
+    frameBuffer.resize(frameSize);
+}
+
+TensorRecording::Writer::~Writer()
+{
+    if (file != nullptr)
+    {
+        fclose(file);
+    }
+}
+
+void TensorRecording::Writer::write(const Frame &frame, const void *const *inputs, const void *const *outputs)
+{
+    if (frameCount == 0)
+    {
+        firstSubmitTimeNs = frame.submitTimeNs;
+    }
+
+    memset(frameBuffer.data(), 0, frameSize);
+
+    Frame relativeFrame = frame;
+    relativeFrame.submitTimeNs -= firstSubmitTimeNs;
+    memcpy(frameBuffer.data(), &relativeFrame, sizeof(Frame));
+
+    for (size_t i = 0; i < tensors.size(); i++)
+    {
+        const void *tensorData = i < inputCount ? (inputs != nullptr ? inputs[i] : nullptr) : outputs[i - inputCount];
+
+        if (tensors[i].offset == 0 || tensorData == nullptr)
+        {
+            continue;
+        }
+
+        memcpy(frameBuffer.data() + tensors[i].offset, tensorData, tensors[i].size);
+    }
+
+    if (fwrite(frameBuffer.data(), frameSize, 1, file) != 1)
+    {
+        throw std::runtime_error("Can't write recording frame " + std::to_string(frameCount));
+    }
+
+    frameCount++;
+}
+
+uint64_t TensorRecording::Writer::getFrameCount() const
+{
+    return frameCount;
+}
+
+TensorRecording::Reader::Reader(const std::string &filePath)
+{
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Can't open recording " + filePath);
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(Header))
+    {
+        close(fd);
+        throw std::runtime_error("Invalid recording " + filePath);
+    }
+
+    size = fileStat.st_size;
+
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED)
+    {
+        throw std::runtime_error("Can't map recording " + filePath);
+    }
+
+    data = (const char *)mapped;
+    header = (const Header *)data;
+    tensors = (const Tensor *)(data + sizeof(Header));
+
+    uint64_t tensorCount = (uint64_t)header->inputCount + header->outputCount;
+    bool isValid = memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 && header->version == VERSION &&
+                   header->frameSize >= sizeof(Frame) && header->frameOffset <= size &&
+                   header->frameOffset >= sizeof(Header) + sizeof(Tensor) * tensorCount;
+
+    // the tensors are copied out of a frame as they are, e.g. by the replay of the VIPLite stub
+    for (uint64_t i = 0; isValid && i < tensorCount; i++)
+    {
+        bool isNotRecorded = i < header->inputCount && tensors[i].offset == 0;
+        isValid = isNotRecorded || (tensors[i].offset >= sizeof(Frame) &&
+                                    (uint64_t)tensors[i].offset + tensors[i].size <= header->frameSize);
+    }
+
+    if (!isValid)
+    {
+        munmap(mapped, size);
+        throw std::runtime_error(filePath + " isn't a tensor recording");
+    }
+
+    // a frame cut short by a crash is ignored
+    frameCount = (size - header->frameOffset) / header->frameSize;
+}
+
+TensorRecording::Reader::~Reader()
+{
+    munmap((void *)data, size);
+}
+
+const TensorRecording::Header &TensorRecording::Reader::getHeader() const
+{
+    return *header;
+}
+
+const TensorRecording::Tensor &TensorRecording::Reader::getInput(int index) const
+{
+    if (index < 0 || index >= (int)header->inputCount)
+    {
+        throw std::out_of_range("Invalid recorded input: " + std::to_string(index));
+    }
+
+    return tensors[index];
+}
+
+const TensorRecording::Tensor &TensorRecording::Reader::getOutput(int index) const
+{
+    if (index < 0 || index >= (int)header->outputCount)
+    {
+        throw std::out_of_range("Invalid recorded output: " + std::to_string(index));
+    }
+
+    return tensors[header->inputCount + index];
+}
+
+uint64_t TensorRecording::Reader::getFrameCount() const
+{
+    return frameCount;
+}
+
+const TensorRecording::Frame &TensorRecording::Reader::getFrame(uint64_t frameIndex) const
+{
+    if (frameIndex >= frameCount)
+    {
+        throw std::out_of_range("Invalid recorded frame: " + std::to_string(frameIndex));
+    }
+
+    return *(const Frame *)(data + header->frameOffset + frameIndex * header->frameSize);
+}
+
+const void *TensorRecording::Reader::getInputData(uint64_t frameIndex, int index) const
+{
+    const Tensor &tensor = getInput(index);
+
+    if (tensor.offset == 0)
+    {
+        return nullptr;
+    }
+
+    return (const char *)&getFrame(frameIndex) + tensor.offset;
+}
+
+const void *TensorRecording::Reader::getOutputData(uint64_t frameIndex, int index) const
+{
+    return (const char *)&getFrame(frameIndex) + getOutput(index).offset;
+}
@@ -2,6 +2,7 @@
 
 #include <opencv2/opencv.hpp>
 #include <thread>
+#include <chrono>
 #include <atomic>
 #include <vector>
 #include <stdexcept>
@@ -9,6 +10,7 @@
 #include <fstream>
 #include <linux/fb.h>
 #include <stdint.h>
+#include <stdlib.h> // for posix_memalign
 #include <linux/videodev2.h>
 #include <time.h>
 #include <sys/stat.h>
@@ -17,31 +19,84 @@
 #include <functional>
 #include <sstream>
 #include <iomanip>
+#include <future>
+#include <mutex>
+#include <exception>
 
 #include "YoloV8Processor.hpp"
 #include "NeuralNetworkRuntime.hpp"
 #include "ThreadSafeQueue.hpp"
+#include "QueueClosedException.hpp"
+#include "LetterboxQuantizer.hpp"
+#include "ResizeEngine.hpp"
 
 class VideoObjectDetectionPipeline::Impl {
 private:
+    // the letterbox transform of a frame travels with it, so its boxes are mapped with its own geometry
+    struct PreprocessedFrame {
+        int bufferSlot;
+        YoloV8Processor::LetterboxTransform transform;
+    };
+
+    struct InferenceResult {
+        int bufferSlot;
+        NeuralNetworkRuntime::Ticket ticket;
+        YoloV8Processor::LetterboxTransform transform;
+    };
+
+    struct FrameDetections {
+        std::vector<YoloV8Processor::Detection> detections;
+        YoloV8Processor::LetterboxTransform transform;
+    };
+
     YoloV8Processor yoloV8Processor;
     NeuralNetworkRuntime nnRuntime;
 
     std::atomic<bool> done;
-    ThreadSafeQueue<cv::Mat> preprocessQueue;
-    ThreadSafeQueue<cv::Mat> inferenceQueue;
-    ThreadSafeQueue<std::vector<float>> resultQueue;
-    ThreadSafeQueue<std::vector<YoloV8Processor::Detection>> detectionQueue;
+    std::atomic<bool> isStopped{false};
+    // the runtime and the input memories are gone, only once no stage thread runs
+    bool isReleased = false;
+    // the error of the first stage that failed, rethrown by start()
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    // indexes into capturedFrames, which keep their memory, so the steady state doesn't allocate
+    ThreadSafeQueue<int> preprocessQueue;
+    ThreadSafeQueue<int> freeFrameQueue;
+    ThreadSafeQueue<int> freeBufferSlotQueue;
+    ThreadSafeQueue<PreprocessedFrame> inferenceQueue;
+    ThreadSafeQueue<InferenceResult> resultQueue;
+    ThreadSafeQueue<FrameDetections> detectionQueue;
 
     std::thread captureThread;
     std::thread preprocessingThread;
     std::thread inferenceThread;
     std::thread postprocessingThread;
 
-    std::vector<YoloV8Processor::Detection> currentDetections;
+    FrameDetections currentDetections;
+
+    // one waits in preprocessQueue, one is pre-processed
+    static const int CAPTURED_FRAME_COUNT = 2;
+    cv::Mat capturedFrames[CAPTURED_FRAME_COUNT];
+    // made for the camera frame size once the first frame is there
+    std::unique_ptr<LetterboxQuantizer> letterboxQuantizer;
+    FrameDetections frameDetections;
+    YoloV8Processor::PostProcessContext postProcessContext;
+    NeuralNetworkRuntime::Stats nnRuntimeStats;
+
+    VideoObjectDetectionPipeline::IdlePolicy idlePolicy;
+    std::atomic<unsigned int> inferencePauseMs{0};
+
+    // page aligned NPU input memory of each buffer slot, the pre-processing writes straight into it
+    std::vector<void *> inputMemories;
 
     uint32_t frameCount = 0; 
 
+    // the network is prepared in the background while the camera and the framebuffer come up
+    std::shared_future<void> nnRuntimeReady;
+
+    uint64_t startTime = 0;
+    std::atomic<bool> isFirstDetectionLogged{false};
+
     static uint64_t get_perf_count()
     {
         struct timespec ts;
@@ -51,6 +106,11 @@ private:
         return (uint64_t)((uint64_t)ts.tv_nsec + (uint64_t)ts.tv_sec * 1000000000);
     }
 
+    void logStartupEvent(const char *event)
+    {
+        std::cout << "startup +" << (get_perf_count() - startTime) / 1000000 << " ms: " << event << std::endl;
+    }
+
     static void saveVectorToFile(const std::vector<float>& vec, const std::string& filename) {
         std::ofstream outFile(filename);
         if (!outFile) {
@@ -78,6 +138,8 @@ private:
             throw std::runtime_error("Can't initialize camera capture");
         }
 
+        logStartupEvent("camera opened");
+
         int fd = open("/dev/fb0", O_RDWR);
         if (fd < 0) {
             throw std::runtime_error("Can't open framebuffer device");
@@ -112,14 +174,30 @@ private:
             throw std::invalid_argument("Unsupported image format: Must be 8 bits per pixel and 3 channels!");
         }
 
-        preprocessQueue.push(frame.clone());
+        pushCapturedFrame(frame);
+
+        cv::Mat displayFrame;
+        cv::Mat displayFrame565;
 
-        cv::resize(frame, frame, displaySize);
-        cv::cvtColor(frame, frame, cv::COLOR_BGR2BGR565);
+        // the camera keeps its size, so the taps of the display resize are computed once
+        ResizeEngine::Config displayResizeConfig;
+        displayResizeConfig.srcSize = frame.size();
+        displayResizeConfig.dstSize = displaySize;
+        if (displaySize.width < frame.cols && displaySize.height < frame.rows) {
+            displayResizeConfig.interpolation = ResizeEngine::INTERPOLATION_AREA;
+        }
+        ResizeEngine displayResizeEngine(displayResizeConfig);
+
+        displayResizeEngine.run(frame, displayFrame);
+        cv::cvtColor(displayFrame, displayFrame565, cv::COLOR_BGR2BGR565);
 
         std::ofstream ofs("/dev/fb0"); // 打开帧缓冲区
 
-        ofs.write(reinterpret_cast<char*>(frame.data), frame.total() * frame.elemSize());
+        logStartupEvent("framebuffer ready");
+
+        ofs.write(reinterpret_cast<char*>(displayFrame565.data), displayFrame565.total() * displayFrame565.elemSize());
+
+        logStartupEvent("first frame displayed");
 
         while (!done.load()) {
             videoCapture >> frame;
@@ -132,87 +210,166 @@ private:
                 throw std::invalid_argument("Unsupported image format: Must be 8 bits per pixel and 3 channels!");
             }
 
+            // keep feeding frames so the inference stage always has the next frame to load
+            if(preprocessQueue.isEmpty()) {
+                frameCount++;
+                pushCapturedFrame(frame);
+            }
+
             if(!detectionQueue.isEmpty()) {
-                if(preprocessQueue.isEmpty()) {
-                    frameCount++;
-                    preprocessQueue.push(frame.clone());
-                }
-                currentDetections = detectionQueue.pop();
+                detectionQueue.pop(currentDetections);
             }
 
-            yoloV8Processor.drawBoundingBox(frame, currentDetections);
+            yoloV8Processor.drawBoundingBox(frame, currentDetections.detections, currentDetections.transform);
 
+            // never in place, so frame, displayFrame and displayFrame565 keep their size and memory
+            const cv::Mat *shownFrame = &frame;
             if (frame.rows != displaySize.width && frame.cols != displaySize.height) {
-                cv::resize(frame, frame, displaySize);
+                displayResizeEngine.run(frame, displayFrame);
+                shownFrame = &displayFrame;
             }
 
-            cv::cvtColor(frame, frame, cv::COLOR_BGR2BGR565);
+            cv::cvtColor(*shownFrame, displayFrame565, cv::COLOR_BGR2BGR565);
 
             ofs.seekp(0);
-            ofs.write(reinterpret_cast<char*>(frame.data), frame.total() * frame.elemSize());
+            ofs.write(reinterpret_cast<char*>(displayFrame565.data), displayFrame565.total() * displayFrame565.elemSize());
         }
     }
 
-    void preprocessFrames()
+    void pushCapturedFrame(const cv::Mat &frame)
     {
-        while (!done.load()) {
-            //BGR
-            auto frame = preprocessQueue.pop();
+        int frameIndex = freeFrameQueue.pop();
 
-            yoloV8Processor.preProcess(frame);
+        frame.copyTo(capturedFrames[frameIndex]);
 
-            // auto tmpFrame = frame.clone();
+        preprocessQueue.push(frameIndex);
+    }
 
-            inferenceQueue.push(frame);
+    void attachInputMemories()
+    {
+        size_t pageSize = sysconf(_SC_PAGESIZE);
+        size_t memorySize = (nnRuntime.getInputBufferSize(0) + pageSize - 1) / pageSize * pageSize;
 
-            // cv::cvtColor(tmpFrame, tmpFrame, cv::COLOR_BGR2RGB);
-            // std::ostringstream filename;
-            // filename << "frames/frame_" << std::setw(6) << std::setfill('0') << frameCount << ".jpg";
-            // cv::imwrite(filename.str(), tmpFrame);
+        for (int bufferSlot = 0; bufferSlot < nnRuntime.getBufferSlotCount(); bufferSlot++) {
+            void *inputMemory = nullptr;
+            if (posix_memalign(&inputMemory, pageSize, memorySize) != 0) {
+                throw std::bad_alloc();
+            }
+            inputMemories.push_back(inputMemory);
 
+            nnRuntime.attachInputHandle(bufferSlot, 0, inputMemory, memorySize);
+
+            freeBufferSlotQueue.push(bufferSlot);
         }
     }
 
-    void onLoadingInputData(int bufferIndex, void *buffer, NeuralNetworkRuntime::InputDataFormat elementDataFormat) {
-   
+    void freeInputMemories()
+    {
+        for (auto inputMemory : inputMemories) {
+            free(inputMemory);
+        }
+        inputMemories.clear();
+    }
 
-        if (bufferIndex != 0) {
-            throw std::invalid_argument("Invalid buffer index! must to be 0!");
+    LetterboxQuantizer &getLetterboxQuantizer(const cv::Mat &frame)
+    {
+        if (letterboxQuantizer && letterboxQuantizer->getConfig().srcSize == frame.size()) {
+            return *letterboxQuantizer;
         }
 
-        // BRG
-        auto frame = inferenceQueue.pop();
+        letterboxQuantizer.reset(new LetterboxQuantizer(frame.size(), nnRuntime.getInputTensor(0)));
 
-        size_t total = frame.total();
+        if (letterboxQuantizer->getOutputSize() > nnRuntime.getInputBufferSize(0)) {
+            throw std::invalid_argument("Pre-processed frame doesn't fit into the NPU input buffer!");
+        }
 
-        uint8_t* uint8Buffer = static_cast<uint8_t*>(buffer);
+        return *letterboxQuantizer;
+    }
 
-        // BRG to RRR...GGG...BBB...
-        int channel = 1;
-        for (int i = 0; i < total; i++) {
-            uint8Buffer[i + channel * total] = frame.data[i * 3 + channel];
-        }
+    void preprocessFrames()
+    {
+        while (!done.load()) {
+            //BGR
+            int frameIndex = preprocessQueue.pop();
+
+            int bufferSlot = freeBufferSlotQueue.pop();
+
+            // resized, padded, planar and quantised in one pass straight into the NPU input memory
+            const cv::Mat &frame = capturedFrames[frameIndex];
+            PreprocessedFrame preprocessedFrame = {
+                .bufferSlot = bufferSlot,
+                .transform = yoloV8Processor.preProcess(frame, getLetterboxQuantizer(frame), inputMemories[bufferSlot])
+            };
+
+            freeFrameQueue.push(frameIndex);
+
+            inferenceQueue.push(preprocessedFrame);
 
-        channel = 2;
-        for (int i = 0; i < total; i++) {
-            uint8Buffer[i + channel * total] = frame.data[i * 3 + channel];
         }
+    }
 
-        channel = 0;
-        for (int i = 0; i < total; i++) {
-            uint8Buffer[i + channel * total] = frame.data[i * 3 + channel];
+    void pauseInference()
+    {
+        unsigned int pauseMs = inferencePauseMs.load();
+
+        // in steps, so stop() isn't held up by a long pause
+        while (pauseMs > 0 && !done.load()) {
+            unsigned int stepMs = pauseMs < 100 ? pauseMs : 100;
+            std::this_thread::sleep_for(std::chrono::milliseconds(stepMs));
+            pauseMs -= stepMs;
         }
     }
 
     void performInference()
     {
+        // the preview runs meanwhile, the slots are pre-processed and wait in the queue
+        nnRuntimeReady.get();
+
+        logStartupEvent("NPU ready");
+
+        PreprocessedFrame pendingFrame = inferenceQueue.pop();
+        NeuralNetworkRuntime::Ticket pendingTicket = nnRuntime.submit(pendingFrame.bufferSlot);
+
         while (!done.load()) {
+            pauseInference();
+
+            // frame N+1 is pre-processed into its slot while frame N is on the NPU
+            PreprocessedFrame preprocessedFrame = inferenceQueue.pop();
+
+            NeuralNetworkRuntime::Ticket ticket = nnRuntime.submit(preprocessedFrame.bufferSlot);
+
+            // the slot of frame N is handed over to the post-processing, which releases it
+            InferenceResult result = {
+                .bufferSlot = pendingFrame.bufferSlot,
+                .ticket = pendingTicket,
+                .transform = pendingFrame.transform
+            };
 
-            auto results = nnRuntime.run([this](int bufferIndex, void *buffer, NeuralNetworkRuntime::InputDataFormat elementDataFormat){
-                this->onLoadingInputData(bufferIndex, buffer, elementDataFormat);
-            });
+            pendingFrame = preprocessedFrame;
+            pendingTicket = ticket;
 
-            resultQueue.push(results[0]);
+            resultQueue.push(result);
+        }
+    }
+
+    static int toCvDepth(NeuralNetworkRuntime::InputDataFormat dataFormat)
+    {
+        switch (dataFormat)
+        {
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_FP32:
+                return CV_32F;
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_FP16:
+                return CV_16F;
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT8:
+                return CV_8U;
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_INT8:
+                return CV_8S;
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_UINT16:
+                return CV_16U;
+            case NeuralNetworkRuntime::InputDataFormat::FORMAT_INT16:
+                return CV_16S;
+            default:
+                throw std::invalid_argument("Unsupported output data format: " + std::to_string(dataFormat));
         }
     }
 
@@ -221,9 +378,45 @@ private:
         while (!done.load()) {
             auto result = resultQueue.pop();
 
-            auto detections = yoloV8Processor.postProcess(CV_32FC1, (void *)result.data());
+            // read the raw NPU output in place, no dequantised copy
+            NeuralNetworkRuntime::OutputTensor outputTensor;
+            try
+            {
+                outputTensor = nnRuntime.mapOutput(result.ticket, 0);
+            }
+            catch(const InferenceTimeoutException& e)
+            {
+                // the runtime has rebuilt the network already, only this frame is lost
+                std::cerr << "processResults: " << e.what() << '\n';
+
+                nnRuntime.releaseOutputs(result.ticket);
+                freeBufferSlotQueue.push(result.bufferSlot);
+                continue;
+            }
+
+            yoloV8Processor.postProcess(
+                toCvDepth(outputTensor.dataFormat),
+                const_cast<void *>(outputTensor.data),
+                outputTensor.scale,
+                outputTensor.zeroPoint,
+                frameDetections.detections,
+                postProcessContext);
+            frameDetections.transform = result.transform;
+
+            nnRuntime.releaseOutputs(result.ticket);
 
-            detectionQueue.push(detections);
+            freeBufferSlotQueue.push(result.bufferSlot);
+
+            if (idlePolicy) {
+                nnRuntime.stats(nnRuntimeStats);
+                inferencePauseMs.store(idlePolicy(frameDetections.detections.size(), nnRuntimeStats.resumeTime.p95));
+            }
+
+            if (!isFirstDetectionLogged.exchange(true)) {
+                logStartupEvent("first detection");
+            }
+
+            detectionQueue.push(frameDetections);
         }
     }
 
@@ -241,86 +434,161 @@ private:
         NeuralNetworkRuntime::Config nnRuntimeConfig = {
             .isAutoInit = false,
             .modelFilePath = config.modelFilePath,
-            .memSize = config.nnRuntimeMemSize
+            .memSize = config.nnRuntimeMemSize,
+            .bufferSlotCount = config.nnRuntimeBufferSlotCount,
+            .isProfiling = config.isNnRuntimeProfiling,
+            .inferenceTimeoutMs = config.nnRuntimeInferenceTimeoutMs,
+            .targetInferenceTimeUs = config.nnRuntimeTargetFramePeriodUs,
+            .idlePowerOffMs = config.nnRuntimeIdlePowerOffMs
         };
+        nnRuntimeConfig.recordFilePath = config.nnRuntimeRecordFilePath;
 
         return NeuralNetworkRuntime(nnRuntimeConfig);
     }
 
+    // Wakes every stage blocked on a queue, their pop throws QueueClosedException.
+    void closeQueues()
+    {
+        preprocessQueue.close();
+        freeFrameQueue.close();
+        freeBufferSlotQueue.close();
+        inferenceQueue.close();
+        resultQueue.close();
+        detectionQueue.close();
+    }
+
+    void fail(std::exception_ptr stageError)
+    {
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = stageError;
+            }
+        }
+
+        done.store(true);
+        closeQueues();
+    }
+
+    // A stage that throws stops the whole pipeline, the other stages would wait for it forever otherwise.
+    void runStage(const char *name, void (Impl::*stage)())
+    {
+        try
+        {
+            (this->*stage)();
+        }
+        catch(const QueueClosedException&)
+        {
+            // another stage failed or stop() was called
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << name << ": " << e.what() << '\n';
+            fail(std::current_exception());
+        }
+    }
+
 public:
     Impl(VideoObjectDetectionPipeline::Config& config) :
         yoloV8Processor(createYoloV8Processor(config)),
         nnRuntime(createNeuralNetworkRuntime(config)),
         done(false),
         preprocessQueue(1),
-        inferenceQueue(1),
+        freeFrameQueue(CAPTURED_FRAME_COUNT),
+        freeBufferSlotQueue(config.nnRuntimeBufferSlotCount),
+        inferenceQueue(config.nnRuntimeBufferSlotCount),
         resultQueue(1),
-        detectionQueue(1)
+        detectionQueue(1),
+        idlePolicy(config.idlePolicy)
     {
-
+        for (int frameIndex = 0; frameIndex < CAPTURED_FRAME_COUNT; frameIndex++) {
+            freeFrameQueue.push(frameIndex);
+        }
     }
 
     void start() {
-        nnRuntime.create();
+        startTime = get_perf_count();
 
-        captureThread = std::thread([this]() {
-            try
-            {
-                this->captureFrames();
-            }
-            catch(const std::exception& e)
-            {
-                std::cerr << "captureThread: " << e.what() << '\n';
-            }
-        });
-        preprocessingThread = std::thread([this]() {
-            try
-            {
-                this->preprocessFrames();
-            }
-            catch(const std::exception& e)
-            {
-                std::cerr << "preprocessingThread: " << e.what() << '\n';
-            }
-        });
-        inferenceThread = std::thread([this]() {
-            try
-            {
-                this->performInference();
-            }
-            catch(const std::exception& e)
-            {
-                std::cerr << "inferenceThread: " << e.what() << '\n';
-            }
-        });
-        postprocessingThread = std::thread([this]() {
-            try
-            {
-                this->processResults();
-            }
-            catch(const std::exception& e)
-            {
-                std::cerr << "postprocessingThread: " << e.what() << '\n';
-            }
-        });
+        nnRuntimeReady = nnRuntime.createAsync();
+
+        attachInputMemories();
+
+        logStartupEvent("runtime created, network preparing");
+
+        captureThread = std::thread(&Impl::runStage, this, "captureThread", &Impl::captureFrames);
+        preprocessingThread = std::thread(&Impl::runStage, this, "preprocessingThread", &Impl::preprocessFrames);
+        inferenceThread = std::thread(&Impl::runStage, this, "inferenceThread", &Impl::performInference);
+        postprocessingThread = std::thread(&Impl::runStage, this, "postprocessingThread", &Impl::processResults);
 
         captureThread.join();
         preprocessingThread.join();
         inferenceThread.join();
         postprocessingThread.join();
+
+        release();
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    static void printStats(const char *name, const LatencyHistogram::Percentiles &percentiles)
+    {
+        std::cout << name << ": count " << percentiles.count
+                  << ", p50 " << percentiles.p50
+                  << ", p95 " << percentiles.p95
+                  << ", p99 " << percentiles.p99
+                  << ", max " << percentiles.max << std::endl;
+    }
+
+    void printStats()
+    {
+        NeuralNetworkRuntime::Stats stats = nnRuntime.stats();
+
+        printStats("npu inference us", stats.npuInferenceTime);
+        printStats("npu cycles", stats.npuCycles);
+        printStats("submit to complete us", stats.submitToCompleteTime);
+        printStats("driver overhead us", stats.driverOverheadTime);
+        printStats("input flush us", stats.inputFlushTime);
+        printStats("output map us", stats.outputMapTime);
+        printStats("recovery us", stats.recoveryTime);
+        std::cout << "timeouts: " << stats.timeoutCount << std::endl;
+        std::cout << "npu clock: " << stats.clockScalePercent << "%, changed " << stats.clockScaleChangeCount << " times" << std::endl;
+        printStats("resume us", stats.resumeTime);
+        printStats("first inference after resume us", stats.firstInferenceAfterResumeTime);
+        std::cout << "power offs: " << stats.powerOffCount << std::endl;
+        for (size_t i = 0; i < stats.deviceInferenceCounts.size(); i++) {
+            std::cout << "device " << i << " inferences: " << stats.deviceInferenceCounts[i] << std::endl;
+        }
     }
 
+    // Only wakes the stages, start() releases the runtime once they are joined.
     void stop() {
+        if (isStopped.exchange(true)) {
+            return;
+        }
         std::cerr << "call stop!!!" << std::endl;
         done.store(true);
+        closeQueues();
+    }
+
+    // The preprocessing stage writes into the input memories and the postprocessing one reads mapped outputs,
+    // so this runs after their threads are joined.
+    void release() {
+        if (isReleased) {
+            return;
+        }
+        isReleased = true;
+        printStats();
         nnRuntime.destroy();
+        freeInputMemories();
     }
 
     ~Impl()
     {
-        if (!done.load()) {
-            stop();
-        }
+        stop();
+        // start() was never called or threw before its stages were started
+        release();
         std::cout << "VideoObjectDetectionPipeline destroyed!" << std::endl;
     }
 };
@@ -339,4 +607,27 @@ void VideoObjectDetectionPipeline::start() {
 
 void VideoObjectDetectionPipeline::stop() {
     _pImpl->stop();
+}
+
+VideoObjectDetectionPipeline::IdlePolicy VideoObjectDetectionPipeline::createEmptySceneIdlePolicy(unsigned int emptyFrameCount, unsigned int pauseMs) {
+    // only called from the post-processing thread
+    std::shared_ptr<unsigned int> emptyFrames = std::make_shared<unsigned int>(0);
+
+    return [emptyFrames, emptyFrameCount, pauseMs](size_t detectionCount, unsigned int resumeTimeUs) -> unsigned int {
+        if (detectionCount > 0) {
+            *emptyFrames = 0;
+            return 0;
+        }
+
+        if (++*emptyFrames < emptyFrameCount) {
+            return 0;
+        }
+
+        // gating doesn't pay off if waking up costs a good part of the pause
+        if (resumeTimeUs > pauseMs * 100) {
+            return 0;
+        }
+
+        return pauseMs;
+    };
 } 
\ No newline at end of file
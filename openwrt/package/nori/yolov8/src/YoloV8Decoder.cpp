@@ -0,0 +1,287 @@
+#include "YoloV8Decoder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "Dequantizer.hpp"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define YOLOV8_DECODER_NEON 1
+#endif
+
+namespace
+{
+    Dequantizer::Function getDequantizer(int depth)
+    {
+        switch (depth)
+        {
+            case CV_32F:
+                return Dequantizer::fp32ToFp32;
+            case CV_16F:
+                return Dequantizer::fp16ToFp32;
+            case CV_8S:
+                return Dequantizer::int8ToFp32;
+            case CV_8U:
+                return Dequantizer::uint8ToFp32;
+            case CV_16S:
+                return Dequantizer::int16ToFp32;
+            default:
+                throw std::invalid_argument("Unsupported output data type: " + std::to_string(depth));
+        }
+    }
+
+    size_t getElementSize(int depth)
+    {
+        switch (depth)
+        {
+            case CV_8S:
+            case CV_8U:
+                return 1;
+            case CV_16F:
+            case CV_16S:
+                return 2;
+            default:
+                return 4;
+        }
+    }
+
+    // best = max(best, scores), bestClassIds = classId where scores won
+    void updateBest(const float *scores, uint32_t classId, float *best, uint32_t *bestClassIds, int count)
+    {
+        int i = 0;
+
+#ifdef YOLOV8_DECODER_NEON
+        const uint32x4_t classIds = vdupq_n_u32(classId);
+
+        for (; i + 4 <= count; i += 4)
+        {
+            float32x4_t score = vld1q_f32(scores + i);
+            float32x4_t bestScore = vld1q_f32(best + i);
+            uint32x4_t isBetter = vcgtq_f32(score, bestScore);
+
+            vst1q_f32(best + i, vbslq_f32(isBetter, score, bestScore));
+            vst1q_u32(bestClassIds + i, vbslq_u32(isBetter, classIds, vld1q_u32(bestClassIds + i)));
+        }
+#endif
+
+        for (; i < count; i++)
+        {
+            if (scores[i] > best[i])
+            {
+                best[i] = scores[i];
+                bestClassIds[i] = classId;
+            }
+        }
+    }
+
+#ifdef YOLOV8_DECODER_NEON
+    inline int16x8_t loadWidened(const int8_t *values)
+    {
+        return vmovl_s8(vld1_s8(values));
+    }
+
+    inline int16x8_t loadWidened(const uint8_t *values)
+    {
+        return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(values)));
+    }
+
+    inline int16x8_t loadWidened(const int16_t *values)
+    {
+        return vld1q_s16(values);
+    }
+#endif
+
+    template <typename T>
+    void initBest(const T *scores, int16_t *best, int count)
+    {
+        int i = 0;
+
+#ifdef YOLOV8_DECODER_NEON
+        for (; i + 8 <= count; i += 8)
+        {
+            vst1q_s16(best + i, loadWidened(scores + i));
+        }
+#endif
+
+        for (; i < count; i++)
+        {
+            best[i] = scores[i];
+        }
+    }
+
+    // same as above on raw quantised scores, a positive scale keeps their order
+    template <typename T>
+    void updateBest(const T *scores, uint16_t classId, int16_t *best, uint16_t *bestClassIds, int count)
+    {
+        int i = 0;
+
+#ifdef YOLOV8_DECODER_NEON
+        const uint16x8_t classIds = vdupq_n_u16(classId);
+
+        for (; i + 8 <= count; i += 8)
+        {
+            int16x8_t score = loadWidened(scores + i);
+            int16x8_t bestScore = vld1q_s16(best + i);
+            uint16x8_t isBetter = vcgtq_s16(score, bestScore);
+
+            vst1q_s16(best + i, vbslq_s16(isBetter, score, bestScore));
+            vst1q_u16(bestClassIds + i, vbslq_u16(isBetter, classIds, vld1q_u16(bestClassIds + i)));
+        }
+#endif
+
+        for (; i < count; i++)
+        {
+            if (scores[i] > best[i])
+            {
+                best[i] = scores[i];
+                bestClassIds[i] = classId;
+            }
+        }
+    }
+}
+
+int32_t YoloV8Decoder::getQuantizedThreshold(float threshold, float scale, int zeroPoint)
+{
+    // (q - zeroPoint) * scale > threshold is q > threshold / scale + zeroPoint, and for an integer q the floor of it
+    double quantized = std::floor((double)threshold / scale + zeroPoint);
+
+    return (int32_t)std::min(std::max(quantized, (double)INT32_MIN), (double)INT32_MAX);
+}
+
+template <typename T>
+void YoloV8Decoder::decodeQuantized(const Output &output, float threshold, std::vector<int> &classIds, std::vector<float> &confidences, std::vector<cv::Rect2d> &boxes)
+{
+    int anchorCount = output.anchorCount;
+    const T *data = static_cast<const T *>(output.data);
+    const T *classRows = data + 4 * anchorCount;
+    float scale = output.scale;
+    int zeroPoint = output.zeroPoint;
+
+    bestValues.resize(anchorCount);
+    bestQuantizedClassIds.assign(anchorCount, 0);
+
+    initBest(classRows, bestValues.data(), anchorCount);
+
+    for (int c = 1; c < output.classCount; c++)
+    {
+        updateBest(classRows + c * anchorCount, c, bestValues.data(), bestQuantizedClassIds.data(), anchorCount);
+    }
+
+    int32_t quantizedThreshold = getQuantizedThreshold(threshold, scale, zeroPoint);
+
+    // only the few anchors above the threshold are dequantised
+    for (int a = 0; a < anchorCount; a++)
+    {
+        if (bestValues[a] <= quantizedThreshold)
+        {
+            continue;
+        }
+
+        float cx = (data[a] - zeroPoint) * scale;
+        float cy = (data[anchorCount + a] - zeroPoint) * scale;
+        float width = (data[2 * anchorCount + a] - zeroPoint) * scale;
+        float height = (data[3 * anchorCount + a] - zeroPoint) * scale;
+
+        boxes.emplace_back(cx - 0.5f * width, cy - 0.5f * height, width, height);
+        confidences.push_back((bestValues[a] - zeroPoint) * scale);
+        classIds.push_back(bestQuantizedClassIds[a]);
+    }
+}
+
+void YoloV8Decoder::decode(const Output &output, float threshold, std::vector<int> &classIds, std::vector<float> &confidences, std::vector<cv::Rect2d> &boxes)
+{
+    Dequantizer::Function dequantize = getDequantizer(output.depth);
+    size_t elementSize = getElementSize(output.depth);
+    int anchorCount = output.anchorCount;
+    const uint8_t *data = static_cast<const uint8_t *>(output.data);
+    size_t rowSize = anchorCount * elementSize;
+
+    classIds.clear();
+    confidences.clear();
+    boxes.clear();
+
+    if (output.classCount <= 0 || anchorCount <= 0)
+    {
+        return;
+    }
+
+    if (output.scale > 0.0f && output.classCount <= UINT16_MAX)
+    {
+        switch (output.depth)
+        {
+            case CV_8S:
+                decodeQuantized<int8_t>(output, threshold, classIds, confidences, boxes);
+                return;
+            case CV_8U:
+                decodeQuantized<uint8_t>(output, threshold, classIds, confidences, boxes);
+                return;
+            case CV_16S:
+                decodeQuantized<int16_t>(output, threshold, classIds, confidences, boxes);
+                return;
+            default:
+                break;
+        }
+    }
+
+    bestScores.resize(anchorCount);
+    bestClassIds.assign(anchorCount, 0);
+    scoreRow.resize(anchorCount);
+
+    // the first class starts the running max, the rest update it row by row
+    const uint8_t *classRows = data + 4 * rowSize;
+    dequantize(classRows, bestScores.data(), anchorCount, output.scale, output.zeroPoint);
+
+    for (int c = 1; c < output.classCount; c++)
+    {
+        const uint8_t *row = classRows + c * rowSize;
+        const float *scores;
+
+        if (output.depth == CV_32F)
+        {
+            scores = reinterpret_cast<const float *>(row);
+        }
+        else
+        {
+            dequantize(row, scoreRow.data(), anchorCount, output.scale, output.zeroPoint);
+            scores = scoreRow.data();
+        }
+
+        updateBest(scores, c, bestScores.data(), bestClassIds.data(), anchorCount);
+    }
+
+    for (int a = 0; a < anchorCount; a++)
+    {
+        if (!(bestScores[a] > threshold))
+        {
+            continue;
+        }
+
+        float box[4];
+        for (int i = 0; i < 4; i++)
+        {
+            dequantize(data + i * rowSize + a * elementSize, &box[i], 1, output.scale, output.zeroPoint);
+        }
+
+        float cx = box[0];
+        float cy = box[1];
+        float width = box[2];
+        float height = box[3];
+
+        boxes.emplace_back(cx - 0.5f * width, cy - 0.5f * height, width, height);
+        confidences.push_back(bestScores[a]);
+        classIds.push_back(bestClassIds[a]);
+    }
+}
+
+bool YoloV8Decoder::isNeonEnabled()
+{
+#ifdef YOLOV8_DECODER_NEON
+    return true;
+#else
+    return false;
+#endif
+}
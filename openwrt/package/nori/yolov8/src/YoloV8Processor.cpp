@@ -1,28 +1,51 @@
 #include "YoloV8Processor.hpp"
 
 #include <cmath>
+#include <cstdio>
 #include <iostream>
+#include <stdexcept>
 
-#define min(a, b) (((a) < (b)) ? (a) : (b))
+#include "LetterboxQuantizer.hpp"
+#include "NmsEngine.hpp"
+#include "YoloV8Decoder.hpp"
+
+struct YoloV8Processor::PostProcessContext::Buffers
+{
+    YoloV8Decoder decoder;
+    std::vector<int> classIds;
+    std::vector<float> confidences;
+    std::vector<cv::Rect2d> boxes;
+    NmsEngine nmsEngine;
+    std::vector<int> nmsResult;
+};
 
 class YoloV8Processor::Impl
 {
 private:
     YoloV8Processor::Config config;
     std::vector<cv::Scalar> colors;
+    NmsEngine::Config nmsConfig;
     int strideNum = 0;
-    int signalResultNum = 0;
 
-    float scaleRatio = 1;
-    int heightPadding = 0;
-    int widthPadding = 0;
+    static LetterboxTransform toTransform(const LetterboxQuantizer::Geometry &geometry)
+    {
+        LetterboxTransform transform;
+        transform.scaleRatio = geometry.scaleRatio;
+        transform.left = geometry.content.x;
+        transform.top = geometry.content.y;
 
+        return transform;
+    }
 
 public:
     Impl(YoloV8Processor::Config &config)
         : config(config), colors(config.classes.size())
     {
-        for(int i = 0; i < config.classes.size(); i++) {
+        nmsConfig.iouThreshold = config.iouThreshold;
+        nmsConfig.isClassAware = config.isClassAwareNms;
+        nmsConfig.maxDetections = config.maxDetections;
+
+        for (size_t i = 0; i < config.classes.size(); i++) {
             cv::RNG rng(cv::getTickCount());
             colors[i] = cv::Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
         }
@@ -33,8 +56,6 @@ public:
             int feat_height = config.imgSize.height / stride;
             strideNum += feat_width * feat_height;
         }
-
-        signalResultNum = config.classes.size() + 4;
     }
 
     Impl(const Impl &other) = delete;
@@ -43,11 +64,8 @@ public:
     Impl(Impl &&other) noexcept
         : config(std::move(other.config)),
           colors(std::move(other.colors)),
-          strideNum(other.strideNum),
-          signalResultNum(other.signalResultNum),
-          scaleRatio(other.scaleRatio),
-          heightPadding(other.heightPadding),
-          widthPadding(other.heightPadding)
+          nmsConfig(other.nmsConfig),
+          strideNum(other.strideNum)
     {
 
     }
@@ -58,97 +76,74 @@ public:
         {
             config = std::move(other.config);
             colors = std::move(other.colors);
+            nmsConfig = other.nmsConfig;
             strideNum = other.strideNum;
-            signalResultNum = other.signalResultNum;
-            scaleRatio = other.scaleRatio;
-            heightPadding = other.heightPadding;
-            widthPadding = other.widthPadding;
         }
         return *this;
     }
 
-    void preProcess(cv::Mat &img)
+    LetterboxTransform preProcess(const cv::Mat &img, cv::Mat &letterboxedImg) const
     {
-        int imgHeight = img.rows;
-        int imgWidth = img.cols;
+        LetterboxQuantizer::Geometry geometry = LetterboxQuantizer::getGeometry(img.size(), config.imgSize);
 
-        if (imgHeight == config.imgSize.height && imgWidth == config.imgSize.width) {
-            return;
+        if (img.size() == config.imgSize) {
+            img.copyTo(letterboxedImg);
+            return toTransform(geometry);
         }
 
-        scaleRatio = min( (float)config.imgSize.height / imgHeight, (float)config.imgSize.width / imgWidth);
-        scaleRatio = min(scaleRatio, 1.0f);
+        letterboxedImg.create(config.imgSize, img.type());
+        letterboxedImg.setTo(cv::Scalar(114, 114, 114));
 
-        int unpaddedImgHeight = static_cast<int>(round(imgHeight * scaleRatio));
-        int unpaddedImgWidth = static_cast<int>(round(imgWidth * scaleRatio));
+        // resized straight into the letterbox, which keeps its memory
+        cv::Mat content = letterboxedImg(geometry.content);
+        cv::resize(img, content, geometry.content.size());
+
+        return toTransform(geometry);
+    }
 
-        if (scaleRatio <= 1.0f)
-        {   
-            cv::Size unpaddedImgSize(unpaddedImgWidth, unpaddedImgHeight);
-            cv::resize(img, img, unpaddedImgSize);
+    LetterboxTransform preProcess(const cv::Mat &img, LetterboxQuantizer &letterboxQuantizer, void *inputBuffer) const
+    {
+        if (letterboxQuantizer.getConfig().dstSize != config.imgSize)
+        {
+            throw std::invalid_argument("The letterbox size doesn't match the image size of the processor");
         }
 
-        heightPadding = config.imgSize.height - unpaddedImgHeight;
-        widthPadding = config.imgSize.width - unpaddedImgWidth;
-
-        float deltaHeight = heightPadding * 0.5f;
-        float deltaWidth = widthPadding * 0.5f;
-        int top = static_cast<int>(round(deltaHeight - 0.1));
-        int bottom = static_cast<int>(round(deltaHeight + 0.1));
-        int left = static_cast<int>(round(deltaWidth - 0.1));
-        int right = static_cast<int>(round(deltaWidth + 0.1));
-        cv::Scalar value(114, 114, 114);
-        cv::copyMakeBorder(img, img, top, bottom, left, right, cv::BORDER_CONSTANT, value);
+        letterboxQuantizer.run(img, inputBuffer);
+
+        return toTransform(letterboxQuantizer.getGeometry());
     }
 
-    std::vector<Detection> postProcess(int dataElementType, void *data)
+    void postProcess(int dataElementType, void *data, float scale, int zeroPoint, std::vector<Detection> &detections,
+                     PostProcessContext::Buffers &buffers) const
     {
+        std::vector<int> &classIds = buffers.classIds;
+        std::vector<float> &confidences = buffers.confidences;
+        std::vector<cv::Rect2d> &boxes = buffers.boxes;
+        std::vector<int> &nmsResult = buffers.nmsResult;
 
-        cv::Mat mat = cv::Mat(signalResultNum, strideNum, dataElementType, data);
-        cv::transpose(mat, mat);
-
-        if (dataElementType != CV_32F)
-        {
-            mat.convertTo(mat, CV_32F);
-        }
+        YoloV8Decoder::Output output;
+        output.data = data;
+        output.depth = CV_MAT_DEPTH(dataElementType);
+        output.scale = scale;
+        output.zeroPoint = zeroPoint;
+        output.classCount = config.classes.size();
+        output.anchorCount = strideNum;
 
-        float *rawData = (float *)mat.data;
+        buffers.decoder.decode(output, config.rectConfidenceThreshold, classIds, confidences, boxes);
 
-        std::vector<int> classIds;
-        std::vector<float> confidences;
-        std::vector<cv::Rect2d> boxes;
+        NmsEngine &nmsEngine = buffers.nmsEngine;
+        nmsEngine.clear();
 
-        for (int i = 0; i < strideNum; i++)
+        for (size_t i = 0; i < boxes.size(); i++)
         {
-            float *classesScores = rawData + 4;
-            cv::Mat scores(1, config.classes.size(), CV_32FC1, classesScores);
-            cv::Point classId;
-            double maxClassScore;
-            cv::minMaxLoc(scores, NULL, &maxClassScore, NULL, &classId);
-            if (maxClassScore > config.rectConfidenceThreshold)
-            {
-                float cx = rawData[0];
-                float cy = rawData[1];
-                float width = rawData[2];
-                float height = rawData[3];
-                float x = cx - 0.5f * width;
-                float y = cy - 0.5f * height;
-
-                cv::Rect2d box(x, y, width, height);
-                
-                boxes.push_back(box);
-                confidences.push_back(maxClassScore);
-                classIds.push_back(classId.x);
-            }
-            rawData += signalResultNum;
+            nmsEngine.add(boxes[i], confidences[i], classIds[i]);
         }
 
-        std::vector<int> nmsResult;
-        cv::dnn::NMSBoxes(boxes, confidences, config.rectConfidenceThreshold, config.iouThreshold, nmsResult, 0.5f);
+        nmsEngine.run(nmsConfig, nmsResult);
 
-        std::vector<Detection> detections(nmsResult.size());
+        detections.resize(nmsResult.size());
 
-        for (int i = 0; i < nmsResult.size(); i++)
+        for (size_t i = 0; i < nmsResult.size(); i++)
         {
             int idx = nmsResult[i];
 
@@ -160,29 +155,30 @@ public:
 
             detections[i] = detection;
         }
-
-        return detections;
     }
 
-    void drawBoundingBox(cv::Mat &img, std::vector<Detection> &detections)
+    void drawBoundingBox(cv::Mat &img, const std::vector<Detection> &detections, const LetterboxTransform &transform) const
     {
-        float deltaWidth = widthPadding * 0.5f;
-        float deltaHeight = heightPadding * 0.5f;
+        // one per drawing thread, keeps its memory from frame to frame
+        static thread_local std::string label;
 
-        for (int i = 0; i < detections.size(); i++)
+        for (size_t i = 0; i < detections.size(); i++)
         {
 
             auto &detection = detections[i];
 
-            std::string label = config.classes[detection.classId] + " " +
-                                std::to_string(detection.confidence).substr(0, std::to_string(detection.confidence).size() - 4);
+            char confidence[16];
+            snprintf(confidence, sizeof(confidence), " %.2f", detection.confidence);
+
+            label.assign(config.classes[detection.classId]);
+            label.append(confidence);
 
-            auto &box = detection.box;
+            cv::Rect2d box = transform.toFrame(detection.box);
 
-            int x1 = std::round(box.x - deltaWidth) / scaleRatio;
-            int y1 = std::round(box.y - deltaHeight) / scaleRatio;
-            int x2 = std::round((box.x + box.width - deltaWidth) / scaleRatio);
-            int y2 = std::round((box.y + box.height - deltaHeight) / scaleRatio);
+            int x1 = std::round(box.x);
+            int y1 = std::round(box.y);
+            int x2 = std::round(box.x + box.width);
+            int y2 = std::round(box.y + box.height);
 
             cv::rectangle(
                 img,
@@ -225,19 +221,53 @@ YoloV8Processor &YoloV8Processor::operator=(YoloV8Processor &&other) noexcept
     return *this;
 }
 
-void YoloV8Processor::preProcess(cv::Mat &img)
+YoloV8Processor::LetterboxTransform YoloV8Processor::preProcess(cv::Mat &img) const
 {
-    _pImpl->preProcess(img);
+    cv::Mat letterboxedImg;
+    LetterboxTransform transform = _pImpl->preProcess(img, letterboxedImg);
+    img = letterboxedImg;
+
+    return transform;
+}
+
+YoloV8Processor::LetterboxTransform YoloV8Processor::preProcess(const cv::Mat &img, cv::Mat &letterboxedImg) const
+{
+    return _pImpl->preProcess(img, letterboxedImg);
+}
+
+YoloV8Processor::LetterboxTransform YoloV8Processor::preProcess(const cv::Mat &img, LetterboxQuantizer &letterboxQuantizer, void *inputBuffer) const
+{
+    return _pImpl->preProcess(img, letterboxQuantizer, inputBuffer);
+}
+
+std::vector<YoloV8Processor::Detection> YoloV8Processor::postProcess(int dataElementType, void *data, float scale, int zeroPoint) const
+{
+    std::vector<Detection> detections;
+    PostProcessContext context;
+    _pImpl->postProcess(dataElementType, data, scale, zeroPoint, detections, *context.buffers);
+    return detections;
+}
+
+void YoloV8Processor::postProcess(int dataElementType, void *data, float scale, int zeroPoint, std::vector<Detection> &detections,
+                                  PostProcessContext &context) const
+{
+    _pImpl->postProcess(dataElementType, data, scale, zeroPoint, detections, *context.buffers);
 }
 
-std::vector<YoloV8Processor::Detection> YoloV8Processor::postProcess(int dataElementType, void *data)
+void YoloV8Processor::drawBoundingBox(cv::Mat &img, const std::vector<Detection> &detections, const LetterboxTransform &transform) const
 {
-    return _pImpl->postProcess(dataElementType, data);
+    _pImpl->drawBoundingBox(img, detections, transform);
 }
 
-void YoloV8Processor::drawBoundingBox(cv::Mat &img, std::vector<Detection> &detections)
+YoloV8Processor::PostProcessContext::PostProcessContext()
+    : buffers(new Buffers())
 {
-    _pImpl->drawBoundingBox(img, detections);
 }
 
+YoloV8Processor::PostProcessContext::PostProcessContext(PostProcessContext &&other) noexcept = default;
+
+YoloV8Processor::PostProcessContext &YoloV8Processor::PostProcessContext::operator=(PostProcessContext &&other) noexcept = default;
+
+YoloV8Processor::PostProcessContext::~PostProcessContext() = default;
+
 YoloV8Processor::~YoloV8Processor() = default;
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// Picks the lowest NPU clock scale which still finishes an inference within the target time.
+// The worst time of a window of inferences is compared to the target: above upperLoad the clock goes up at once,
+// below lowerLoad for scaleDownWindowCount windows in a row it goes down. Both aim at targetLoad of the target time,
+// assuming the inference time is inversely proportional to the clock.
+class ClockScaler
+{
+public:
+    struct Config
+    {
+        unsigned int targetTimeUs = 0;
+        unsigned int minScalePercent = 10;
+        unsigned int windowSize = 16;
+        unsigned int scaleDownWindowCount = 4;
+        float upperLoad = 0.9f;
+        float targetLoad = 0.75f;
+        float lowerLoad = 0.6f;
+    };
+
+    ClockScaler(const Config &config);
+
+    // Adds the time of one inference run at the current scale.
+    // Returns the new scale in percent when it should change, 0 otherwise.
+    unsigned int update(uint32_t timeUs);
+
+    unsigned int getScalePercent() const;
+
+    // Back to full clock, e.g. after the driver reset the frequency.
+    void reset();
+
+private:
+    Config config;
+
+    unsigned int scalePercent = 100;
+    unsigned int windowCount = 0;
+    uint32_t windowMaxTimeUs = 0;
+    unsigned int lowLoadWindowCount = 0;
+
+    unsigned int getTargetScalePercent(uint32_t timeUs) const;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+class Dequantizer
+{
+public:
+    // Converts count elements to fp32, the real value of element q is (q - zeroPoint) * scale.
+    // Dynamic fixed point is the case zeroPoint = 0, scale = 2^-fixedPointPos.
+    typedef void (*Function)(const void *src, float *dst, size_t count, float scale, int zeroPoint);
+
+    static void int8ToFp32(const void *src, float *dst, size_t count, float scale, int zeroPoint);
+
+    static void uint8ToFp32(const void *src, float *dst, size_t count, float scale, int zeroPoint);
+
+    static void int16ToFp32(const void *src, float *dst, size_t count, float scale, int zeroPoint);
+
+    static void fp16ToFp32(const void *src, float *dst, size_t count, float scale, int zeroPoint);
+
+    static void fp32ToFp32(const void *src, float *dst, size_t count, float scale, int zeroPoint);
+
+    // true if the kernels above were built with ARM NEON
+    static bool isNeonEnabled();
+
+private:
+    Dequantizer() = delete;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <sstream>
+
+// Thrown for the ticket of an inference which was cancelled because it ran past Config::inferenceTimeoutMs.
+class InferenceTimeoutException : public std::runtime_error
+{
+public:
+    InferenceTimeoutException(unsigned long long ticket, unsigned int timeoutMs)
+        : std::runtime_error(buildErrorMessage(ticket, timeoutMs)), ticket(ticket) {}
+
+    unsigned long long getTicket() const
+    {
+        return ticket;
+    }
+
+private:
+    unsigned long long ticket;
+
+    static std::string buildErrorMessage(unsigned long long ticket, unsigned int timeoutMs)
+    {
+        std::ostringstream oss;
+        oss << "inference of ticket " << ticket << " was cancelled after " << timeoutMs << " ms";
+        return oss.str();
+    }
+};
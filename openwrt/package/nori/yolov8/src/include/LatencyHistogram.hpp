@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Log-linear histogram of unsigned 32-bit samples, 8 buckets per power of two (at most 12.5% error).
+// record() is lock-free and can run in any thread while another one reads the percentiles.
+class LatencyHistogram
+{
+public:
+    struct Percentiles
+    {
+        unsigned long long count = 0;
+        unsigned int p50 = 0;
+        unsigned int p95 = 0;
+        unsigned int p99 = 0;
+        unsigned int max = 0;
+        double mean = 0.0;
+    };
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram &other) = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &other) = delete;
+
+    void record(uint32_t value);
+
+    // Buckets are read one by one, a concurrent record() can be missed but nothing is torn.
+    Percentiles getPercentiles() const;
+
+    void reset();
+
+private:
+    static const int SUB_BUCKET_BITS = 3;
+    static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int BUCKET_COUNT = (32 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    static int getBucketIndex(uint32_t value);
+
+    // the largest value of a bucket, so a percentile is never under-reported
+    static uint32_t getBucketUpperBound(int bucketIndex);
+
+    std::atomic<uint32_t> buckets[BUCKET_COUNT];
+    std::atomic<unsigned long long> sum;
+    std::atomic<uint32_t> max;
+};
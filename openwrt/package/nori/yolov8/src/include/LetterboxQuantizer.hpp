@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "NeuralNetworkRuntime.hpp"
+#include "ResizeEngine.hpp"
+
+// Letterboxes a BGR frame straight into a planar, quantised network input in one pass over the frame:
+// every output row is resized by a ResizeEngine, padded, split into its planes and quantised
+// while the source rows are still in the cache. NEON when built for ARM, a lookup table otherwise.
+// The taps are computed once for the frame size, and the row buffers are kept, so run() doesn't allocate.
+// Not thread-safe, every thread needs its own.
+class LetterboxQuantizer
+{
+public:
+    struct Config
+    {
+        cv::Size srcSize;
+        cv::Size dstSize;
+        NeuralNetworkRuntime::InputDataFormat dataFormat = NeuralNetworkRuntime::FORMAT_UINT8;
+        // The real value of element q is (q - zeroPoint) * scale, dynamic fixed point is zeroPoint = 0, scale = 2^-fixedPointPos.
+        float scale = 1.0f / 255;
+        int zeroPoint = 0;
+        // real value of pixel value p
+        float pixelScale = 1.0f / 255;
+        unsigned char padValue = 114;
+        // plane 0 is red, otherwise the planes keep the BGR order of the frame
+        bool isRgb = false;
+        ResizeEngine::Interpolation interpolation = ResizeEngine::INTERPOLATION_BILINEAR;
+    };
+
+    struct Geometry
+    {
+        // of the resize, never above 1
+        float scaleRatio;
+        // the resized frame within the output, the rest is padding
+        cv::Rect content;
+    };
+
+    // Same sizes and rounding as YoloV8Processor::preProcess.
+    static Geometry getGeometry(const cv::Size &srcSize, const cv::Size &dstSize);
+
+    explicit LetterboxQuantizer(const Config &config);
+
+    // Quantises for inputTensor from NeuralNetworkRuntime::getInputTensor, which has to be [w, h, 3] or [w, h, 3, 1].
+    // An int8 input without quantisation or with dynamic fixed point gets pixel - 128, the latter with a warning.
+    LetterboxQuantizer(const cv::Size &srcSize, const NeuralNetworkRuntime::OutputTensor &inputTensor);
+
+    const Config &getConfig() const;
+
+    const Geometry &getGeometry() const;
+
+    // bytes written by run()
+    size_t getOutputSize() const;
+
+    // frame has to be CV_8UC3 of Config::srcSize, output getOutputSize() bytes, e.g. a mapped NPU input.
+    void run(const cv::Mat &frame, void *output);
+
+    // true if run() was built with ARM NEON
+    static bool isNeonEnabled();
+
+private:
+    Config config;
+    Geometry geometry;
+    size_t elementSize;
+    bool isResizing;
+    ResizeEngine resizeEngine;
+
+    // the output element of every pixel value, as raw bits
+    uint32_t lut[256];
+    float quantScale;
+
+    // one resized output row, interleaved and then planar with NEON
+    std::vector<uint8_t> resizedRow;
+    std::vector<uint8_t> pixelRow;
+
+    static Config makeConfig(const cv::Size &srcSize, const NeuralNetworkRuntime::OutputTensor &inputTensor);
+
+    static ResizeEngine::Config makeResizeConfig(const Config &config, const Geometry &geometry);
+
+    void createLut();
+
+    void splitRow(const uint8_t *src);
+
+    void quantizeRow(const uint8_t *src, uint8_t *dst, int count) const;
+
+    // one interleaved row of the content into the quantised planes, in plane order
+    void splitQuantizeRow(const uint8_t *src, uint8_t *planes[3]);
+
+    void fillRow(uint8_t *dst, int count) const;
+};
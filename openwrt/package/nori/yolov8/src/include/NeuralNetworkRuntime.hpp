@@ -1,8 +1,13 @@
 #pragma once
 
 #include <vector>
+#include <string>
 #include <memory>
 #include <functional>
+#include <future>
+
+#include "LatencyHistogram.hpp"
+#include "InferenceTimeoutException.hpp"
 
 class NeuralNetworkRuntime
 {
@@ -18,13 +23,124 @@ public:
         FORMAT_INT16
     };
 
+    enum QuantFormat
+    {
+        QUANT_NONE,
+        QUANT_DYNAMIC_FIXED_POINT,
+        QUANT_AFFINE
+    };
+
+    // Read-only view of a mapped output buffer, the real value of element q is (q - zeroPoint) * scale.
+    struct OutputTensor
+    {
+        const void *data = nullptr;
+        InputDataFormat dataFormat = FORMAT_UNKNOWN;
+        QuantFormat quantFormat = QUANT_NONE;
+        int fixedPointPos = 0;
+        float scale = 1.0f;
+        int zeroPoint = 0;
+        // [w, h, c, n] order
+        unsigned int numOfDims = 0;
+        unsigned int sizes[6] = {0};
+        unsigned int elementCount = 0;
+    };
+
     typedef std::function<void(int bufferIndex, void *buffer, InputDataFormat elementDataFormat)> LoadingInputDataCallback;
 
+    // Identifies one submitted inference, 0 is never a valid ticket.
+    typedef unsigned long long Ticket;
+
+    enum ModelLoadMode
+    {
+        // malloc + fread, the binary is in memory twice while the network is created
+        MODEL_LOAD_READ,
+        // read-only mmap of the binary, pages are read ahead and dropped once the network is created
+        MODEL_LOAD_MMAP,
+        // the driver reads the file itself (VIP_CREATE_NETWORK_FROM_FILE)
+        MODEL_LOAD_FROM_FILE
+    };
+
+    enum DispatchPolicy
+    {
+        // buffer slots go to the devices in turn
+        DISPATCH_ROUND_ROBIN,
+        // to the idle device with the least busy time per core
+        DISPATCH_LEAST_LOADED
+    };
+
+    // Config::memSize value which sizes vip_init from the memory pool and buffers of the model
+    static const unsigned int MEM_SIZE_AUTO = 0;
+
     struct Config
     {
         bool isAutoInit = true;
         std::string modelFilePath = "";
-        unsigned int memSize = 17 * 1024 * 1024;
+        unsigned int memSize = MEM_SIZE_AUTO;
+        // Number of input/output buffer sets, use 2 or more to load frame N+1 while frame N is on the NPU.
+        unsigned int bufferSlotCount = 2;
+        // Gives every buffer slot its own vip_weak_dup_network command buffer with the slot buffers attached once,
+        // so a submit is only a trigger. Otherwise all slots share one network and are re-attached when they change.
+        bool isNetworkPerBufferSlot = true;
+        // MEM_SIZE_AUTO only: added on top of the measured size, and the size of the probing vip_init
+        unsigned int memSizeMargin = 1 * 1024 * 1024;
+        unsigned int autoMemProbeSize = 1 * 1024 * 1024;
+        // Uses the memory pool of NpuContext instead of a private one, only for networks that never run at the same time.
+        bool isSharedMemoryPool = false;
+        ModelLoadMode modelLoadMode = MODEL_LOAD_MMAP;
+        // Queries VIP_NETWORK_PROP_PROFILING after every inference for the npu* and driverOverheadTime stats.
+        bool isProfiling = false;
+        // Cancels an inference which runs longer, its ticket then throws InferenceTimeoutException. 0 waits forever.
+        unsigned int inferenceTimeoutMs = 0;
+        // Re-creates and re-prepares the network after a cancel, the buffers and attached inputs stay.
+        bool isRebuildingAfterTimeout = true;
+        // Lowers the NPU clock (vip_power_management) as long as inferences stay well within this time, 0 keeps the full clock.
+        // The profiled NPU time is used with isProfiling, the submit to complete time otherwise.
+        unsigned int targetInferenceTimeUs = 0;
+        unsigned int minClockScalePercent = 10;
+        // Powers the NPU off (vip_power_management) when nothing was submitted for this long, the next submit()
+        // powers it on again and pays Stats::resumeTime. 0 keeps it powered.
+        unsigned int idlePowerOffMs = 0;
+        // Uses up to this many of the devices reported by vip_query_hardware, 0 for all. Every device gets its own
+        // network, pinned with SET_DEVICE_ID before it is prepared, and runs one inference at a time.
+        // Each network takes its own copy of the binary and its own memory pool in the NPU memory.
+        unsigned int maxDeviceCount = 0;
+        DispatchPolicy dispatchPolicy = DISPATCH_LEAST_LOADED;
+        // VIP_NETWORK_PROP_SET_PRIORITY of all network instances, 0 ~ 255 with 0 the lowest. -1 keeps the driver default.
+        int priority = -1;
+        // Appends the inputs, the raw outputs and the timing of every completed inference to this TensorRecording file,
+        // empty records nothing. The viplite-stub replays such a file without an NPU (VIP_STUB_REPLAY).
+        std::string recordFilePath = "";
+        bool isRecordingInputs = true;
+    };
+
+    // Times are in microseconds.
+    struct Stats
+    {
+        // from VIP_NETWORK_PROP_PROFILING, empty unless Config::isProfiling
+        LatencyHistogram::Percentiles npuInferenceTime;
+        LatencyHistogram::Percentiles npuCycles;
+        // vip_trigger_network until vip_wait_network returns
+        LatencyHistogram::Percentiles submitToCompleteTime;
+        // submitToCompleteTime minus npuInferenceTime
+        LatencyHistogram::Percentiles driverOverheadTime;
+        // cache flush of the inputs in submit()
+        LatencyHistogram::Percentiles inputFlushTime;
+        // cache invalidate and map of an output in mapOutput()
+        LatencyHistogram::Percentiles outputMapTime;
+        // network rebuild after a timeout
+        LatencyHistogram::Percentiles recoveryTime;
+        unsigned long long timeoutCount = 0;
+        // current NPU clock in percent of the full clock
+        unsigned int clockScalePercent = 100;
+        unsigned long long clockScaleChangeCount = 0;
+        // power on in submit() after an idle power off
+        LatencyHistogram::Percentiles resumeTime;
+        // submit to complete time of the inference following a power on
+        LatencyHistogram::Percentiles firstInferenceAfterResumeTime;
+        unsigned long long powerOffCount = 0;
+        bool isPoweredOff = false;
+        // completed inferences of each device
+        std::vector<unsigned long long> deviceInferenceCounts;
     };
 
     NeuralNetworkRuntime(Config &config);
@@ -39,8 +155,78 @@ public:
 
     void create();
 
+    // Creates the network and its buffers, then prepares it in the background.
+    // Buffers can be attached and loaded right away, submit() needs the returned future to be ready.
+    // A failed prepare releases the networks of the devices and leaves its exception in the future,
+    // the buffers and the NPU memory stay until destroy(), which is needed before createAsync() again.
+    std::shared_future<void> createAsync();
+
     std::vector<std::vector<float>> run(const LoadingInputDataCallback& onLoadingInputData);
 
+    // Same as above, but reuses the vectors of results, so a steady loop doesn't allocate after the first run.
+    // Build onLoadingInputData once outside the loop, a std::function holding a large lambda allocates.
+    void run(const LoadingInputDataCallback& onLoadingInputData, std::vector<std::vector<float>> &results);
+
+    int getBufferSlotCount() const;
+
+    // NPU devices the inferences are spread over, see Config::maxDeviceCount. 0 before create().
+    int getDeviceCount() const;
+
+    unsigned int getInputBufferSize(int inputIndex) const;
+
+    InputDataFormat getInputDataFormat(int inputIndex) const;
+
+    // Data format, quantisation and shape of an input, data is nullptr.
+    OutputTensor getInputTensor(int inputIndex) const;
+
+    // Replaces the input buffer of bufferSlot by caller owned memory, which must stay valid until destroy().
+    // handle should be page aligned and size a multiple of 64 bytes.
+    void attachInputHandle(int bufferSlot, int inputIndex, void *handle, unsigned int size);
+
+    // Same as attachInputHandle but for a DMABUF fd, e.g. exported from V4L2. The driver doesn't maintain its CPU cache.
+    void attachInputFd(int bufferSlot, int inputIndex, int fd, unsigned int size);
+
+    void loadInput(int bufferSlot, const LoadingInputDataCallback& onLoadingInputData);
+
+    // Starts the inference of bufferSlot on an idle device without blocking, waits for a device if all are busy.
+    // Doesn't allocate after the first submit of each device.
+    Ticket submit(int bufferSlot);
+
+    // Same as above, but on device 0 ~ getDeviceCount() - 1, waiting for it if it's busy. For a caller which spreads
+    // the inferences of several runtimes over the devices, each runtime only knows about its own.
+    Ticket submit(int bufferSlot, int device);
+
+    // Starts bufferSlots as one vip_group on one device, e.g. the tiles of a frame or the crops of a classifier.
+    // The driver runs them back to back with a single interrupt at the end. Needs Config::isNetworkPerBufferSlot,
+    // and keeping the slot order of a batch lets every batch reuse the same group. Returns the tickets in the same order.
+    std::vector<Ticket> submitBatch(const std::vector<int> &bufferSlots);
+
+    // Blocks until the inference of ticket is finished and returns its outputs.
+    std::vector<std::vector<float>> wait(Ticket ticket);
+
+    // Same as above, but reuses the vectors of results.
+    void wait(Ticket ticket, std::vector<std::vector<float>> &results);
+
+    int getOutputCount() const;
+
+    // Blocks until the inference of ticket is finished and maps the raw output without any conversion.
+    // The view stays valid until releaseOutputs(ticket), the slot of ticket can't be submitted before that.
+    // Throws InferenceTimeoutException if the inference was cancelled, releaseOutputs(ticket) is still needed.
+    OutputTensor mapOutput(Ticket ticket, int outputIndex);
+
+    // Blocks until the inference of ticket is finished, its outputs stay available for mapOutput().
+    void waitFinished(Ticket ticket);
+
+    void releaseOutputs(Ticket ticket);
+
+    // Snapshot, can be called from any thread. Only deviceInferenceCounts takes the runtime lock.
+    Stats stats() const;
+
+    // Same as above, but fills stats in place, deviceInferenceCounts is only allocated the first time.
+    void stats(Stats &stats) const;
+
+    void resetStats();
+
     void destroy();
 
 private:
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+// Greedy non-maximum suppression: boxes are visited by descending score, and a box is dropped when it overlaps a box
+// kept before it by more than the IoU threshold. The boxes are kept as a structure of arrays of corners and areas,
+// sorted once by score, and the overlap test is done without a division.
+// Few candidates are compared against the boxes kept so far, which stops as soon as maxDetections are kept.
+// Many candidates, as in dense scenes, are tracked in a bitmask instead: every kept box computes its row of the
+// overlap matrix against all the boxes after it, four at a time with NEON when available, and ORs it into the mask
+// of suppressed boxes. Rows of suppressed boxes are never needed, so they are never computed, nor are the overlaps
+// of boxes already suppressed. Without NEON the greedy pass is always faster, so the bitmask is only used with it.
+// Keeps its buffers from frame to frame, not thread-safe.
+class NmsEngine
+{
+public:
+    struct Config
+    {
+        float iouThreshold = 0.45f;
+        // boxes of different classes never suppress each other
+        bool isClassAware = true;
+        // the greedy pass stops once this many boxes are kept, 0 for no limit
+        unsigned int maxDetections = 300;
+        // candidates from which the bitmask is used on NEON builds, 0 never
+        unsigned int bitmaskMinCount = 256;
+    };
+
+    // Drops the boxes of the previous run.
+    void clear();
+
+    void add(const cv::Rect2d &box, float score, int classId);
+
+    size_t getCount() const;
+
+    // Replaces kept by the indices, in the order of add(), of the boxes that survive, highest score first.
+    void run(const Config &config, std::vector<int> &kept);
+
+    // true if the overlap rows of the bitmask are computed with ARM NEON
+    static bool isNeonEnabled();
+
+private:
+    // as added
+    std::vector<float> x1s;
+    std::vector<float> y1s;
+    std::vector<float> x2s;
+    std::vector<float> y2s;
+    std::vector<float> scores;
+    std::vector<int32_t> classIds;
+
+    // indices of the boxes by descending score, and the boxes in that order
+    std::vector<int> order;
+    std::vector<float> sortedX1s;
+    std::vector<float> sortedY1s;
+    std::vector<float> sortedX2s;
+    std::vector<float> sortedY2s;
+    std::vector<float> sortedAreas;
+    std::vector<int32_t> sortedClassIds;
+
+    // sorted positions of the kept boxes
+    std::vector<int> keptPositions;
+
+    // bit i is set once sorted box i is suppressed
+    std::vector<uint64_t> suppressedMask;
+
+    void sort();
+
+    bool isOverlapping(int a, int b, float iouThreshold) const;
+
+    void runGreedy(const Config &config, std::vector<int> &kept);
+
+    void runBitmask(const Config &config, std::vector<int> &kept);
+
+    // sets the bits of the sorted boxes after i which i suppresses
+    void suppressOverlapping(int i, const Config &config);
+};
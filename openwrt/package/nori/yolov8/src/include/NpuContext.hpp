@@ -0,0 +1,27 @@
+#pragma once
+
+#include "vip_lite.h"
+
+// Process-wide VIPLite state shared by every NeuralNetworkRuntime.
+class NpuContext
+{
+public:
+    // vip_init on the first acquire, later calls only add a reference and memSize is ignored.
+    static void acquire(unsigned int memSize);
+
+    // vip_destroy when the last reference is released, which should happen in the thread of the first acquire.
+    static void release();
+
+    static bool isInitialized();
+
+    static unsigned int getMemSize();
+
+    // Returns the memory pool buffer shared by networks that never run at the same time.
+    // It is created with the size of the first request, a larger request later throws.
+    static vip_buffer acquireMemoryPool(unsigned int size);
+
+    static void releaseMemoryPool();
+
+private:
+    NpuContext() = delete;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <exception>
+
+#include "NeuralNetworkRuntime.hpp"
+#include "LatencyHistogram.hpp"
+
+// Runs the requests of several networks sharing the NPU, at most one per device at a time, so an urgent request
+// never queues up behind others in the driver. Whenever a device is free, the next request is submitted in the order of
+// 1. requests of models which are behind their rate target,
+// 2. higher priority,
+// 3. earlier deadline,
+// 4. earlier request.
+// A model with a rate target which is ahead of it competes like a best effort model.
+class NpuScheduler
+{
+public:
+    typedef int ModelId;
+
+    struct Config
+    {
+        // requests on the NPU at the same time, 0 for one per device of the runtimes
+        unsigned int maxInFlightCount = 0;
+    };
+
+    // Called in a scheduler thread once the inference is finished, the outputs are then mapped and
+    // released through getRuntime(). error is set and ticket may be 0 if the request failed or was dropped.
+    typedef std::function<void(NeuralNetworkRuntime::Ticket ticket, std::exception_ptr error)> CompletionCallback;
+
+    struct ModelConfig
+    {
+        std::string name = "";
+        // the runtime is created by the scheduler, its priority is set from priority below
+        NeuralNetworkRuntime::Config nnRuntimeConfig;
+        // 0 ~ 255, higher runs first, also the VIP_NETWORK_PROP_SET_PRIORITY of the network. addModel() throws
+        // std::invalid_argument above 255.
+        unsigned int priority = 0;
+        // guaranteed request rate, 0 for best effort
+        float targetFps = 0.0f;
+        // relative to the request, only orders requests of the same priority and counts misses. 0 for none.
+        unsigned int deadlineMs = 0;
+        // the oldest request is dropped when a new one doesn't fit
+        unsigned int maxQueueDepth = 2;
+    };
+
+    // Times are in microseconds.
+    struct ModelStats
+    {
+        std::string name;
+        // request until submit
+        LatencyHistogram::Percentiles queueingDelay;
+        // submit until the inference is finished
+        LatencyHistogram::Percentiles serviceTime;
+        unsigned long long completedCount = 0;
+        unsigned long long droppedCount = 0;
+        unsigned long long failedCount = 0;
+        unsigned long long deadlineMissCount = 0;
+    };
+
+    NpuScheduler();
+
+    explicit NpuScheduler(const Config &config);
+
+    NpuScheduler(const NpuScheduler &other) = delete;
+    NpuScheduler &operator=(const NpuScheduler &other) = delete;
+
+    ~NpuScheduler();
+
+    // Creates the runtime of the model, models can only be added before start().
+    ModelId addModel(const ModelConfig &modelConfig);
+
+    // Inputs are attached and loaded directly, a buffer slot must not be requested again before its completion.
+    NeuralNetworkRuntime &getRuntime(ModelId modelId);
+
+    void start();
+
+    // Pending requests, also those queued before start(), are completed with an error.
+    void stop();
+
+    // Queues the inference of the loaded bufferSlot of the model, requests before start() wait for it.
+    // After stop() the request is completed with an error at once.
+    void request(ModelId modelId, int bufferSlot, const CompletionCallback &onCompleted);
+
+    std::vector<ModelStats> stats() const;
+
+private:
+    class Impl;
+
+    std::unique_ptr<Impl> _pImpl;
+};
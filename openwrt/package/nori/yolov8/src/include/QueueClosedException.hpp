@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdexcept>
+
+// Thrown by ThreadSafeQueue::pop once the queue is closed, so a stage blocked on it can end.
+class QueueClosedException : public std::runtime_error
+{
+public:
+    QueueClosedException() : std::runtime_error("queue is closed") {}
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+// Separable 8-bit resize for a geometry that doesn't change, e.g. camera to network input or to display.
+// The source index and 8-bit fixed-point weights of every output column and row are computed once,
+// a frame is then resized row by row: the source rows an output row needs are resized horizontally
+// into a small ring of 16-bit rows (each source row once per frame), which are blended vertically.
+// With NEON both passes are vectorised, the horizontal one for 3 channels only.
+// Not thread-safe, every thread needs its own.
+class ResizeEngine
+{
+public:
+    enum Interpolation
+    {
+        // pixel centres aligned like cv::INTER_LINEAR
+        INTERPOLATION_BILINEAR,
+        // average of the covered source pixels like cv::INTER_AREA, bilinear along an axis which is enlarged
+        INTERPOLATION_AREA
+    };
+
+    struct Config
+    {
+        cv::Size srcSize;
+        cv::Size dstSize;
+        Interpolation interpolation = INTERPOLATION_BILINEAR;
+        // interleaved 8-bit channels
+        int channels = 3;
+    };
+
+    explicit ResizeEngine(const Config &config);
+
+    const Config &getConfig() const;
+
+    // Resizes src, which has to be CV_8UC(channels) of Config::srcSize, into dst. dst keeps its memory if it's already the right size.
+    void run(const cv::Mat &src, cv::Mat &dst);
+
+    // Row by row use, startFrame() before the first row of every frame.
+    // The rows of a frame have to be resized top to bottom, dst takes dstSize.width * channels bytes.
+    void startFrame();
+
+    void resizeRow(const cv::Mat &src, int dstRow, uint8_t *dst);
+
+    // true if the resize was built with ARM NEON
+    static bool isNeonEnabled();
+
+private:
+    static const int WEIGHT_BITS = 8;
+    static const int WEIGHT_ONE = 1 << WEIGHT_BITS;
+    // source rows per output row, e.g. an area downscale by 15
+    static const int MAX_TAP_COUNT = 16;
+    // output pixels of one NEON step of the horizontal pass
+    static const int LANE_COUNT = 8;
+
+    // the weights of every output pixel start at its first source pixel, tapCount each, zero padded
+    struct Taps
+    {
+        int tapCount = 0;
+        std::vector<int> starts;
+        std::vector<uint16_t> weights;
+        // the same weights for LANE_COUNT output pixels at a time, tap by tap, whole groups only
+        std::vector<uint16_t> laneWeights;
+    };
+
+    Config config;
+    Taps xTaps;
+    Taps yTaps;
+
+    // horizontally resized source rows, source row r is kept in rowBuffers[r % yTaps.tapCount]
+    std::vector<std::vector<uint16_t>> rowBuffers;
+    std::vector<int> bufferedRows;
+
+    static Taps createTaps(int srcSize, int dstSize, Interpolation interpolation);
+
+    void resizeRowHorizontally(const uint8_t *src, uint16_t *dst) const;
+
+    const uint16_t *getResizedRow(const cv::Mat &src, int srcRow);
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+// File of recorded inference frames, every frame has the same size so the file can be mapped and indexed directly:
+//   Header, Tensor[inputCount + outputCount], padding to 64 bytes, then frameCount frames of frameSize bytes each.
+//   A frame is a Frame followed by its inputs and raw outputs, each at Tensor::offset from the frame start.
+// Written in host byte order, the fields mirror vip_buffer_create_params_t.
+class TensorRecording
+{
+public:
+    static const uint32_t VERSION = 1;
+    static const uint32_t ALIGNMENT = 64;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t inputCount;
+        uint32_t outputCount;
+        // 0 if only the outputs are recorded
+        uint32_t isRecordingInputs;
+        uint32_t frameOffset;
+        uint32_t frameSize;
+    };
+
+    struct Tensor
+    {
+        uint32_t numOfDims;
+        uint32_t sizes[6];
+        int32_t dataFormat;
+        int32_t quantFormat;
+        int32_t fixedPointPos;
+        float scale;
+        int32_t zeroPoint;
+        uint32_t size;
+        // from the start of a frame, 0 for inputs that aren't recorded
+        uint32_t offset;
+    };
+
+    struct Frame
+    {
+        uint64_t ticket;
+        // from the submit of the first recorded frame
+        uint64_t submitTimeNs;
+        uint32_t submitToCompleteUs;
+        // 0 unless profiling
+        uint32_t npuTimeUs;
+    };
+
+    // Appends frames to a new file, throws std::runtime_error on I/O errors.
+    class Writer
+    {
+    public:
+        Writer(const std::string &filePath, const std::vector<Tensor> &inputs, const std::vector<Tensor> &outputs, bool isRecordingInputs);
+
+        Writer(const Writer &other) = delete;
+        Writer &operator=(const Writer &other) = delete;
+
+        ~Writer();
+
+        // inputs may be nullptr if they aren't recorded, a nullptr tensor is written as zeros
+        void write(const Frame &frame, const void *const *inputs, const void *const *outputs);
+
+        uint64_t getFrameCount() const;
+
+    private:
+        FILE *file;
+        std::vector<Tensor> tensors;
+        uint32_t inputCount;
+        uint32_t frameSize;
+        uint64_t frameCount = 0;
+        uint64_t firstSubmitTimeNs = 0;
+        std::vector<char> frameBuffer;
+    };
+
+    // Maps a recording read-only, throws std::runtime_error if it can't be read, isn't a recording or a tensor doesn't
+    // fit in its frame.
+    class Reader
+    {
+    public:
+        explicit Reader(const std::string &filePath);
+
+        Reader(const Reader &other) = delete;
+        Reader &operator=(const Reader &other) = delete;
+
+        ~Reader();
+
+        const Header &getHeader() const;
+
+        const Tensor &getInput(int index) const;
+
+        const Tensor &getOutput(int index) const;
+
+        uint64_t getFrameCount() const;
+
+        const Frame &getFrame(uint64_t frameIndex) const;
+
+        // nullptr if the inputs aren't recorded
+        const void *getInputData(uint64_t frameIndex, int index) const;
+
+        const void *getOutputData(uint64_t frameIndex, int index) const;
+
+    private:
+        const char *data;
+        size_t size;
+        const Header *header;
+        const Tensor *tensors;
+        uint64_t frameCount;
+    };
+
+    static uint32_t align(uint32_t size)
+    {
+        return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+private:
+    TensorRecording() = delete;
+};
@@ -1,19 +1,26 @@
 #pragma once
 
-#include <queue>
+#include <vector>
+#include <utility>
 #include <mutex>
 #include <condition_variable>
 #include <stdexcept>
 #include <chrono>
 
+#include "QueueClosedException.hpp"
+
 template<typename T>
 class ThreadSafeQueue {
 private:
-    std::queue<T> queue;
+    // 固定大小的环形缓冲区，push/pop 不再分配内存
+    std::vector<T> ring;
+    size_t head = 0;
+    size_t count = 0;
     mutable std::mutex mutex;
     std::condition_variable condVar;
     std::condition_variable fullCondVar;
     size_t maxSize;
+    bool isClosed = false;
 
     // 添加元素到队列
     bool push(const T& value, std::chrono::milliseconds timeout) {
@@ -21,27 +28,34 @@ private:
         
         if (timeout == std::chrono::milliseconds::min()) {
             // 不等待
-            if (queue.size() >= maxSize) {
+            if (count >= maxSize || isClosed) {
                 return false;
             }
         }
         else if (timeout == std::chrono::milliseconds::max()) {
             // 无限等待直到有空间
-            fullCondVar.wait(lock, [this] { return queue.size() < maxSize; });
+            fullCondVar.wait(lock, [this] { return count < maxSize || isClosed; });
         } else {
             // 等待直到有空间或超时
-            if (!fullCondVar.wait_for(lock, timeout, [this] { return queue.size() < maxSize; })) {
+            if (!fullCondVar.wait_for(lock, timeout, [this] { return count < maxSize || isClosed; })) {
                 return false; // 在超时后放弃
             }
         }
 
-        queue.push(value);
+        // 关闭后丢弃
+        if (isClosed) {
+            return false;
+        }
+
+        // 拷贝赋值复用槽位里已有的容量
+        ring[(head + count) % maxSize] = value;
+        count++;
         condVar.notify_one();
         return true;
     }
 
 public:
-    explicit ThreadSafeQueue(size_t maxSize) : maxSize(maxSize) {}
+    explicit ThreadSafeQueue(size_t maxSize) : ring(maxSize), maxSize(maxSize) {}
     ThreadSafeQueue(const ThreadSafeQueue&) = delete;            // 禁止复制构造
     ThreadSafeQueue& operator=(const ThreadSafeQueue&) = delete; // 禁止赋值操作
 
@@ -59,23 +73,45 @@ public:
 
     // 从队列中弹出元素，如果队列为空则等待
     T pop() {
+        T value{};
+        pop(value);
+        return value;
+    }
+
+    // 与队首槽位交换，value 原有的内存留在队列里给下一次 push 复用
+    // 队列关闭后抛出 QueueClosedException
+    void pop(T& value) {
         std::unique_lock<std::mutex> lock(mutex);
-        condVar.wait(lock, [this]{ return !queue.empty(); });
-        T value = std::move(queue.front());
-        queue.pop();
+        condVar.wait(lock, [this]{ return count > 0 || isClosed; });
+        if (isClosed) {
+            throw QueueClosedException();
+        }
+        using std::swap;
+        swap(value, ring[head]);
+        head = (head + 1) % maxSize;
+        count--;
         fullCondVar.notify_one();
-        return value;
+    }
+
+    // 关闭队列并唤醒所有等待的线程：之后 push 返回 false，pop 抛出 QueueClosedException
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isClosed = true;
+        }
+        condVar.notify_all();
+        fullCondVar.notify_all();
     }
 
     // 检查队列是否为空
     bool isEmpty() const {
         std::lock_guard<std::mutex> lock(mutex);
-        return queue.empty();
+        return count == 0;
     }
 
     // 获取队列的大小
     size_t size() const {
         std::lock_guard<std::mutex> lock(mutex);
-        return queue.size();
+        return count;
     }
 };
\ No newline at end of file
@@ -2,15 +2,34 @@
 
 #include <memory>
 #include <vector>
+#include <functional>
 
 #include <opencv2/opencv.hpp>
 
 class VideoObjectDetectionPipeline {
 public:
 
+    // Called with the result of every frame, returns how long the inference pauses before the next frame, 0 for full rate.
+    // A pause longer than nnRuntimeIdlePowerOffMs powers the NPU off, resumeTimeUs (p95) is what the next frame pays for it.
+    typedef std::function<unsigned int(size_t detectionCount, unsigned int resumeTimeUs)> IdlePolicy;
+
     struct Config {
         std::string modelFilePath = "";
-        unsigned int nnRuntimeMemSize = 17 * 1024 * 1024;
+        // 0 sizes the NPU memory from the model, see NeuralNetworkRuntime::MEM_SIZE_AUTO
+        unsigned int nnRuntimeMemSize = 0;
+        unsigned int nnRuntimeBufferSlotCount = 3;
+        // NPU time and driver overhead in the stats printed by stop()
+        bool isNnRuntimeProfiling = false;
+        // a stalled NPU job is cancelled after this and the frame is dropped, 0 waits forever
+        unsigned int nnRuntimeInferenceTimeoutMs = 1000;
+        // NPU clock is lowered while inferences fit well into this frame period, 0 keeps the full clock
+        unsigned int nnRuntimeTargetFramePeriodUs = 0;
+        // 0 keeps the NPU powered
+        unsigned int nnRuntimeIdlePowerOffMs = 0;
+        // records the NPU inputs and raw outputs of every frame for an offline replay, see NeuralNetworkRuntime::Config
+        std::string nnRuntimeRecordFilePath = "";
+        // empty runs at full rate
+        IdlePolicy idlePolicy;
         std::vector<std::string> detectionClasses;
         cv::Size inputImgSize = {640, 640};
         float rectConfidenceThreshold = 0.25f;
@@ -21,10 +40,14 @@ public:
 
     ~VideoObjectDetectionPipeline();
 
+    // Runs until stop() or until a stage fails, which stops the other stages and is rethrown here.
     void start();
 
     void stop();
 
+    // Pauses pauseMs after emptyFrameCount frames without detections, unless the resume cost is over 10% of the pause.
+    static IdlePolicy createEmptySceneIdlePolicy(unsigned int emptyFrameCount, unsigned int pauseMs);
+
 private:
     class Impl;
 
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+// Finds the anchors of a YOLOv8 output whose best class passes the confidence threshold, reading the
+// channel-major layout of the NPU as it is: the best score and class of all anchors are kept in two rows,
+// which every class row updates with NEON when available. Only the anchors above the threshold get a box.
+// Integer outputs stay quantised: the threshold is converted to the integer domain of the output, the best class is
+// found on the raw values, and only the scores and boxes of the anchors above the threshold are dequantised.
+// Keeps its rows from frame to frame, not thread-safe.
+class YoloV8Decoder
+{
+public:
+    struct Output
+    {
+        // rows cx, cy, w, h, then one row of scores per class, anchorCount elements each
+        const void *data = nullptr;
+        // CV_32F, CV_16F, CV_8S, CV_8U or CV_16S, the real value of element q is (q - zeroPoint) * scale
+        int depth = CV_32F;
+        float scale = 1.0f;
+        int zeroPoint = 0;
+        int classCount = 0;
+        int anchorCount = 0;
+    };
+
+    // Replaces the contents of classIds, confidences and boxes by the anchors whose best score is above threshold.
+    void decode(const Output &output, float threshold, std::vector<int> &classIds, std::vector<float> &confidences, std::vector<cv::Rect2d> &boxes);
+
+    // The largest quantised value whose real value isn't above threshold, for a positive scale.
+    // Dynamic fixed point is the case zeroPoint = 0, scale = 2^-fixedPointPos.
+    static int32_t getQuantizedThreshold(float threshold, float scale, int zeroPoint);
+
+    // true if the class rows are reduced with ARM NEON
+    static bool isNeonEnabled();
+
+private:
+    // fp32 and fp16 outputs
+    std::vector<float> bestScores;
+    std::vector<uint32_t> bestClassIds;
+    // a dequantised class row
+    std::vector<float> scoreRow;
+
+    // integer outputs, raw
+    std::vector<int16_t> bestValues;
+    std::vector<uint16_t> bestQuantizedClassIds;
+
+    template <typename T>
+    void decodeQuantized(const Output &output, float threshold, std::vector<int> &classIds, std::vector<float> &confidences, std::vector<cv::Rect2d> &boxes);
+};
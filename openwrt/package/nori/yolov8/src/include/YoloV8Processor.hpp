@@ -5,6 +5,8 @@
 
 #include <opencv2/opencv.hpp>
 
+class LetterboxQuantizer;
+
 class YoloV8Processor
 {
 public:
@@ -14,6 +16,10 @@ public:
         cv::Size imgSize = {.width = 640, .height = 640};
         float rectConfidenceThreshold = 0.25f;
         float iouThreshold = 0.45f;
+        // boxes of different classes never suppress each other
+        bool isClassAwareNms = true;
+        // at most this many detections per frame, the best ones, 0 for no limit
+        unsigned int maxDetections = 300;
     };
 
     struct Detection
@@ -23,6 +29,40 @@ public:
         cv::Rect2d box;
     };
 
+    // How a frame was letterboxed into the network input, travels with the frame to map its boxes back.
+    struct LetterboxTransform
+    {
+        float scaleRatio = 1.0f;
+        // of the resized frame in the network input
+        int left = 0;
+        int top = 0;
+
+        cv::Rect2d toFrame(const cv::Rect2d &box) const
+        {
+            return cv::Rect2d((box.x - left) / scaleRatio, (box.y - top) / scaleRatio, box.width / scaleRatio, box.height / scaleRatio);
+        }
+    };
+
+    // Scratch buffers of postProcess, reused from frame to frame so a steady stream doesn't allocate.
+    // Every thread calling postProcess needs its own.
+    class PostProcessContext
+    {
+    public:
+        PostProcessContext();
+
+        PostProcessContext(PostProcessContext &&other) noexcept;
+        PostProcessContext &operator=(PostProcessContext &&other) noexcept;
+
+        ~PostProcessContext();
+
+    private:
+        friend class YoloV8Processor;
+
+        struct Buffers;
+
+        std::unique_ptr<Buffers> buffers;
+    };
+
     YoloV8Processor(Config &config);
 
     YoloV8Processor(const YoloV8Processor &yoloV8Processor) = delete;
@@ -31,11 +71,26 @@ public:
     YoloV8Processor(YoloV8Processor &&yoloV8Processor) noexcept;
     YoloV8Processor &operator=(YoloV8Processor &&other) noexcept;
 
-    void preProcess(cv::Mat &img);
+    // The processor doesn't change after construction, all methods can be called from any thread at the same time.
+
+    LetterboxTransform preProcess(cv::Mat &img) const;
+
+    // Letterboxes img into letterboxedImg, which keeps its memory from frame to frame.
+    LetterboxTransform preProcess(const cv::Mat &img, cv::Mat &letterboxedImg) const;
+
+    // Letterboxes and quantises img straight into inputBuffer, e.g. a mapped NPU input, in one pass.
+    // letterboxQuantizer has to be made for the size of img and Config::imgSize, and isn't shared between threads.
+    LetterboxTransform preProcess(const cv::Mat &img, LetterboxQuantizer &letterboxQuantizer, void *inputBuffer) const;
+
+    // data may be quantised, its real value is (data - zeroPoint) * scale
+    std::vector<Detection> postProcess(int dataElementType, void *data, float scale = 1.0f, int zeroPoint = 0) const;
 
-    std::vector<Detection> postProcess(int dataElementType, void *data);
+    // Same as above, but reuses detections and the scratch buffers of context.
+    void postProcess(int dataElementType, void *data, float scale, int zeroPoint, std::vector<Detection> &detections,
+                     PostProcessContext &context) const;
 
-    void drawBoundingBox(cv::Mat &img, std::vector<Detection> &detections);
+    // detections are in network input coordinates, transform is the one preProcess returned for their frame
+    void drawBoundingBox(cv::Mat &img, const std::vector<Detection> &detections, const LetterboxTransform &transform) const;
 
     ~YoloV8Processor();
 
@@ -24,9 +24,10 @@
 
 #include "YoloV8Processor.hpp"
 #include "NeuralNetworkRuntime.hpp"
+#include "LetterboxQuantizer.hpp"
 
 static const char *usage =
-    "Usage:\nmodelFilePath classesFilePath [nnRuntimeMemSzie]";
+    "Usage:\nmodelFilePath classesFilePath [nnRuntimeMemSzie, 0 for auto]";
 
 static bool isDone = false;
 
@@ -140,33 +141,28 @@ int main(int argc, char *argv[])
         // BRG
         cv::Mat frame;
 
+        std::unique_ptr<LetterboxQuantizer> letterboxQuantizer;
+        YoloV8Processor::LetterboxTransform letterboxTransform;
+
         while (!isDone)
         {
             videoCapture >> frame;
 
+            if (!letterboxQuantizer || letterboxQuantizer->getConfig().srcSize != frame.size()) {
+                // pixel - 128 for an int8 input without quantisation, with dynamic fixed point or with scale 1/255
+                // and zero point -128, otherwise the affine parameters of the input
+                letterboxQuantizer.reset(new LetterboxQuantizer(frame.size(), nnRuntime.getInputTensor(0)));
+            }
+
             auto results = nnRuntime.run(
-                [&frame, &yoloV8Processor]
+                [&frame, &yoloV8Processor, &letterboxQuantizer, &letterboxTransform]
                 (int bufferIndex, void *buffer, NeuralNetworkRuntime::InputDataFormat elementDataFormat)
                 {
                     if (bufferIndex != 0) {
                         throw std::invalid_argument("Invalid buffer index! must to be 0!");
                     }
 
-                    auto inputFrame = frame.clone(); 
-
-                    yoloV8Processor.preProcess(inputFrame);
-
-                    size_t total = inputFrame.total();
-
-                    int8_t* int8Buffer = static_cast<int8_t*>(buffer);
-
-                    // BGR to RRR...GGG...BBB...
-                    // uint8 to int8
-                    for(int channel = 2; channel >=0; channel--) {
-                        for (int i = 0; i < total; i++) {
-                            int8Buffer[i + channel * total] = inputFrame.data[i * 3 + channel] - 128;
-                        }
-                    }
+                    letterboxTransform = yoloV8Processor.preProcess(frame, *letterboxQuantizer, buffer);
                 }
             );
 
@@ -174,7 +170,7 @@ int main(int argc, char *argv[])
 
             auto detections = yoloV8Processor.postProcess(CV_32FC1, (void *)result.data());
 
-            yoloV8Processor.drawBoundingBox(frame, detections);
+            yoloV8Processor.drawBoundingBox(frame, detections, letterboxTransform);
 
             cv::resize(frame, frame, displaySize);
 
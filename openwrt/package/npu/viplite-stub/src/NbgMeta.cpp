@@ -0,0 +1,414 @@
+#include "NbgMeta.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <stdlib.h>
+
+namespace
+{
+    // Just enough JSON for nbg_meta.json, objects keep the order of their members
+    struct JsonValue
+    {
+        enum Type
+        {
+            TYPE_NULL,
+            TYPE_BOOL,
+            TYPE_NUMBER,
+            TYPE_STRING,
+            TYPE_ARRAY,
+            TYPE_OBJECT
+        };
+
+        Type type = TYPE_NULL;
+        bool boolean = false;
+        double number = 0;
+        std::string string;
+        std::vector<JsonValue> array;
+        std::vector<std::pair<std::string, JsonValue>> object;
+
+        const JsonValue *find(const std::string &key) const
+        {
+            for (auto &member : object)
+            {
+                if (member.first == key)
+                {
+                    return &member.second;
+                }
+            }
+
+            return nullptr;
+        }
+    };
+
+    class JsonParser
+    {
+    private:
+        const std::string &text;
+        size_t position = 0;
+
+        void fail(const char *what)
+        {
+            throw std::runtime_error(std::string(what) + " at offset " + std::to_string(position));
+        }
+
+        void skipWhitespace()
+        {
+            while (position < text.size() && (text[position] == ' ' || text[position] == '\t' ||
+                                               text[position] == '\n' || text[position] == '\r'))
+            {
+                position++;
+            }
+        }
+
+        bool consume(char c)
+        {
+            skipWhitespace();
+
+            if (position < text.size() && text[position] == c)
+            {
+                position++;
+                return true;
+            }
+
+            return false;
+        }
+
+        void expect(char c)
+        {
+            if (!consume(c))
+            {
+                fail("Unexpected character");
+            }
+        }
+
+        std::string parseString()
+        {
+            expect('"');
+
+            std::string string;
+
+            while (position < text.size() && text[position] != '"')
+            {
+                char c = text[position++];
+
+                if (c == '\\' && position < text.size())
+                {
+                    c = text[position++];
+                    switch (c)
+                    {
+                    case 'n':
+                        c = '\n';
+                        break;
+                    case 't':
+                        c = '\t';
+                        break;
+                    case 'u':
+                        // names are ASCII, keep the escape as it is
+                        string += "\\u";
+                        continue;
+                    default:
+                        break;
+                    }
+                }
+
+                string += c;
+            }
+
+            expect('"');
+
+            return string;
+        }
+
+        JsonValue parseValue()
+        {
+            skipWhitespace();
+
+            if (position >= text.size())
+            {
+                fail("Unexpected end");
+            }
+
+            JsonValue value;
+            char c = text[position];
+
+            if (c == '{')
+            {
+                value.type = JsonValue::TYPE_OBJECT;
+                position++;
+
+                if (consume('}'))
+                {
+                    return value;
+                }
+
+                do
+                {
+                    skipWhitespace();
+                    std::string key = parseString();
+                    expect(':');
+                    value.object.emplace_back(key, parseValue());
+                } while (consume(','));
+
+                expect('}');
+            }
+            else if (c == '[')
+            {
+                value.type = JsonValue::TYPE_ARRAY;
+                position++;
+
+                if (consume(']'))
+                {
+                    return value;
+                }
+
+                do
+                {
+                    value.array.push_back(parseValue());
+                } while (consume(','));
+
+                expect(']');
+            }
+            else if (c == '"')
+            {
+                value.type = JsonValue::TYPE_STRING;
+                value.string = parseString();
+            }
+            else if (text.compare(position, 4, "true") == 0 || text.compare(position, 5, "false") == 0)
+            {
+                value.type = JsonValue::TYPE_BOOL;
+                value.boolean = c == 't';
+                position += value.boolean ? 4 : 5;
+            }
+            else if (text.compare(position, 4, "null") == 0)
+            {
+                position += 4;
+            }
+            else
+            {
+                const char *start = text.c_str() + position;
+                char *end = nullptr;
+
+                value.type = JsonValue::TYPE_NUMBER;
+                value.number = strtod(start, &end);
+
+                if (end == start)
+                {
+                    fail("Invalid value");
+                }
+
+                position += end - start;
+            }
+
+            return value;
+        }
+
+    public:
+        explicit JsonParser(const std::string &text) : text(text) {}
+
+        JsonValue parse()
+        {
+            JsonValue value = parseValue();
+
+            skipWhitespace();
+            if (position != text.size())
+            {
+                fail("Trailing characters");
+            }
+
+            return value;
+        }
+    };
+
+    vip_enum parseDataFormat(const std::string &type)
+    {
+        if (type == "float32")
+        {
+            return VIP_BUFFER_FORMAT_FP32;
+        }
+        if (type == "float16")
+        {
+            return VIP_BUFFER_FORMAT_FP16;
+        }
+        if (type == "u8" || type == "uint8")
+        {
+            return VIP_BUFFER_FORMAT_UINT8;
+        }
+        if (type == "i8" || type == "int8")
+        {
+            return VIP_BUFFER_FORMAT_INT8;
+        }
+        if (type == "u16" || type == "uint16")
+        {
+            return VIP_BUFFER_FORMAT_UINT16;
+        }
+        if (type == "i16" || type == "int16")
+        {
+            return VIP_BUFFER_FORMAT_INT16;
+        }
+        if (type == "i32" || type == "int32")
+        {
+            return VIP_BUFFER_FORMAT_INT32;
+        }
+        if (type == "u32" || type == "uint32")
+        {
+            return VIP_BUFFER_FORMAT_UINT32;
+        }
+        if (type == "bfloat16")
+        {
+            return VIP_BUFFER_FORMAT_BFP16;
+        }
+
+        throw std::runtime_error("Unsupported tensor type: " + type);
+    }
+
+    double getFirstNumber(const JsonValue *value, double defaultValue)
+    {
+        if (value == nullptr)
+        {
+            return defaultValue;
+        }
+
+        if (value->type == JsonValue::TYPE_ARRAY)
+        {
+            return value->array.empty() ? defaultValue : value->array[0].number;
+        }
+
+        return value->number;
+    }
+
+    NbgMeta::Tensor parseTensor(const JsonValue &value)
+    {
+        NbgMeta::Tensor tensor;
+
+        const JsonValue *name = value.find("name");
+        if (name != nullptr)
+        {
+            tensor.name = name->string;
+        }
+
+        const JsonValue *shape = value.find("shape");
+        if (shape == nullptr || shape->array.empty() || shape->array.size() > 6)
+        {
+            throw std::runtime_error("Tensor " + tensor.name + " has no valid shape");
+        }
+
+        // the shape is outermost first
+        for (auto it = shape->array.rbegin(); it != shape->array.rend(); ++it)
+        {
+            tensor.sizes.push_back((vip_uint32_t)it->number);
+        }
+
+        const JsonValue *quantize = value.find("quantize");
+        if (quantize == nullptr)
+        {
+            const JsonValue *dtype = value.find("dtype");
+            tensor.dataFormat = parseDataFormat(dtype != nullptr ? dtype->string : "float32");
+            return tensor;
+        }
+
+        const JsonValue *qtype = quantize->find("qtype");
+        tensor.dataFormat = parseDataFormat(qtype != nullptr ? qtype->string : "u8");
+
+        const JsonValue *quantizer = value.find("quantizer");
+        std::string quantizerName = quantizer != nullptr ? quantizer->string : "";
+
+        if (quantizerName == "asymmetric_affine")
+        {
+            tensor.quantFormat = VIP_BUFFER_QUANTIZE_TF_ASYMM;
+            tensor.scale = getFirstNumber(quantize->find("scale"), 1.0);
+            tensor.zeroPoint = getFirstNumber(quantize->find("zero_point"), 0);
+        }
+        else if (quantizerName == "dynamic_fixed_point")
+        {
+            tensor.quantFormat = VIP_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT;
+            tensor.fixedPointPos = getFirstNumber(quantize->find("fl"), 0);
+        }
+
+        return tensor;
+    }
+
+    std::vector<NbgMeta::Tensor> parseTensors(const JsonValue &root, const char *key)
+    {
+        std::vector<NbgMeta::Tensor> tensors;
+
+        const JsonValue *value = root.find(key);
+        if (value == nullptr || value->type != JsonValue::TYPE_OBJECT)
+        {
+            throw std::runtime_error(std::string("No ") + key + " in the meta file");
+        }
+
+        for (auto &member : value->object)
+        {
+            tensors.push_back(parseTensor(member.second));
+        }
+
+        return tensors;
+    }
+}
+
+NbgMeta NbgMeta::load(const std::string &filePath)
+{
+    std::ifstream file(filePath);
+    if (!file)
+    {
+        throw std::runtime_error("Can't open " + filePath);
+    }
+
+    std::stringstream text;
+    text << file.rdbuf();
+
+    std::string content = text.str();
+    JsonValue root;
+
+    try
+    {
+        root = JsonParser(content).parse();
+    }
+    catch (const std::runtime_error &e)
+    {
+        throw std::runtime_error(filePath + ": " + e.what());
+    }
+
+    NbgMeta meta;
+    meta.inputs = parseTensors(root, "Inputs");
+    meta.outputs = parseTensors(root, "Outputs");
+
+    return meta;
+}
+
+vip_uint32_t NbgMeta::getElementSize(vip_enum dataFormat)
+{
+    switch (dataFormat)
+    {
+    case VIP_BUFFER_FORMAT_UINT8:
+    case VIP_BUFFER_FORMAT_INT8:
+    case VIP_BUFFER_FORMAT_CHAR:
+        return 1;
+    case VIP_BUFFER_FORMAT_FP16:
+    case VIP_BUFFER_FORMAT_BFP16:
+    case VIP_BUFFER_FORMAT_UINT16:
+    case VIP_BUFFER_FORMAT_INT16:
+        return 2;
+    case VIP_BUFFER_FORMAT_INT64:
+    case VIP_BUFFER_FORMAT_UINT64:
+    case VIP_BUFFER_FORMAT_FP64:
+        return 8;
+    default:
+        return 4;
+    }
+}
+
+vip_uint32_t NbgMeta::getTensorSize(const Tensor &tensor)
+{
+    vip_uint32_t size = getElementSize(tensor.dataFormat);
+
+    for (vip_uint32_t dimension : tensor.sizes)
+    {
+        size *= dimension;
+    }
+
+    return size;
+}
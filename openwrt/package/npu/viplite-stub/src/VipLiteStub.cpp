@@ -0,0 +1,1100 @@
+// Host stand-in for libVIPlite, implements vip_lite.h without an NPU.
+//
+// Buffer shapes come from the nbg_meta.json the converter exports with the network binary, looked up in this order:
+//   VIP_STUB_META                path of the meta file, needed for networks created from memory
+//   <model>.json                 next to <model>.nb
+//   nbg_meta.json                in the directory of the model
+//
+// Behaviour is set by environment variables read at the first vip_init:
+//   VIP_STUB_REPLAY              TensorRecording written by NeuralNetworkRuntime (Config::recordFilePath). Replaces the
+//                                meta file, its outputs are replayed in trigger order with their recorded NPU time.
+//   VIP_STUB_OUTPUT_DIR          output_<index>.dat holds recorded frames of output <index>, one after the other.
+//                                They are replayed in trigger order, outputs are zeroed if there is no file.
+//   VIP_STUB_LATENCY_US          simulated inference time at full clock, default 0
+//   VIP_STUB_JITTER_US           uniform +/- jitter added to every inference, default 0
+//   VIP_STUB_DEVICE_COUNT        default 1, every device runs one job at a time
+//   VIP_STUB_HANG_EVERY          every n-th inference never finishes until vip_cancel_network, default 0 (never)
+//   VIP_STUB_RESUME_US           time VIP_POWER_PROPERTY_ON takes after an off, default 0
+//   VIP_STUB_MEMORY_POOL_SIZE    answer of VIP_NETWORK_PROP_MEMORY_POOL_SIZE, default 0
+//
+// The clock scale of VIP_POWER_PROPERTY_SET_FREQUENCY stretches the latency, profiling reports the simulated time.
+// vip_set_network fails on a prepared network, vip_lite.h wants it called before vip_prepare_network.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "vip_lite.h"
+#include "NbgMeta.hpp"
+#include "TensorRecording.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+namespace
+{
+    const vip_uint32_t VERSION = 0x00010800;
+    const vip_uint32_t CID = 0x1000003b;
+    const size_t NAME_SIZE = 64;
+    // cycles reported by the profiling, per simulated us
+    const vip_uint32_t CYCLES_PER_US = 696;
+
+    struct Settings
+    {
+        std::string metaFilePath;
+        std::string replayFilePath;
+        std::string outputDir;
+        // a replay uses the recorded time unless the latency is given
+        bool isLatencySet = false;
+        unsigned int latencyUs = 0;
+        unsigned int jitterUs = 0;
+        unsigned int deviceCount = 1;
+        unsigned int hangEvery = 0;
+        unsigned int resumeUs = 0;
+        vip_uint32_t memoryPoolSize = 0;
+    };
+
+    // Shared by a network and its weak dups, so recorded frames are replayed once across all of them.
+    struct Model
+    {
+        NbgMeta meta;
+        std::vector<std::vector<char>> recordedOutputs;
+        std::shared_ptr<TensorRecording::Reader> replay;
+        size_t frameCount = 0;
+        size_t nextFrame = 0;
+    };
+
+    std::mutex stubMutex;
+    std::condition_variable finishedCondVar;
+
+    int initCount = 0;
+    Settings settings;
+    std::vector<Clock::time_point> deviceBusyUntil;
+    bool isPoweredOff = false;
+    bool isStopped = false;
+    unsigned int clockScalePercent = 100;
+    unsigned long long inferenceCount = 0;
+    std::mt19937 random;
+
+    std::string getEnv(const char *name)
+    {
+        const char *value = getenv(name);
+        return value != nullptr ? value : "";
+    }
+
+    unsigned int getEnvUint(const char *name, unsigned int defaultValue)
+    {
+        std::string value = getEnv(name);
+        return value.empty() ? defaultValue : strtoul(value.c_str(), nullptr, 0);
+    }
+
+    Settings loadSettings()
+    {
+        Settings loaded;
+        loaded.metaFilePath = getEnv("VIP_STUB_META");
+        loaded.replayFilePath = getEnv("VIP_STUB_REPLAY");
+        loaded.outputDir = getEnv("VIP_STUB_OUTPUT_DIR");
+        loaded.isLatencySet = !getEnv("VIP_STUB_LATENCY_US").empty();
+        loaded.latencyUs = getEnvUint("VIP_STUB_LATENCY_US", 0);
+        loaded.jitterUs = getEnvUint("VIP_STUB_JITTER_US", 0);
+        loaded.deviceCount = std::max(1u, getEnvUint("VIP_STUB_DEVICE_COUNT", 1));
+        loaded.hangEvery = getEnvUint("VIP_STUB_HANG_EVERY", 0);
+        loaded.resumeUs = getEnvUint("VIP_STUB_RESUME_US", 0);
+        loaded.memoryPoolSize = getEnvUint("VIP_STUB_MEMORY_POOL_SIZE", 0);
+        return loaded;
+    }
+
+    bool isReadable(const std::string &filePath)
+    {
+        return std::ifstream(filePath).good();
+    }
+
+    std::string findMetaFile(const std::string &modelFilePath)
+    {
+        if (!settings.metaFilePath.empty())
+        {
+            return settings.metaFilePath;
+        }
+
+        if (modelFilePath.empty())
+        {
+            return "";
+        }
+
+        size_t extension = modelFilePath.rfind('.');
+        size_t slash = modelFilePath.rfind('/');
+
+        if (extension != std::string::npos && (slash == std::string::npos || extension > slash))
+        {
+            std::string sidecar = modelFilePath.substr(0, extension) + ".json";
+            if (isReadable(sidecar))
+            {
+                return sidecar;
+            }
+        }
+
+        std::string directory = slash == std::string::npos ? "." : modelFilePath.substr(0, slash);
+
+        return directory + "/nbg_meta.json";
+    }
+
+    void loadRecordedOutputs(Model &model)
+    {
+        if (settings.outputDir.empty())
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < model.meta.outputs.size(); i++)
+        {
+            std::string filePath = settings.outputDir + "/output_" + std::to_string(i) + ".dat";
+            std::ifstream file(filePath, std::ios::binary);
+            if (!file)
+            {
+                continue;
+            }
+
+            std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+            vip_uint32_t frameSize = NbgMeta::getTensorSize(model.meta.outputs[i]);
+            if (data.empty() || data.size() % frameSize != 0)
+            {
+                throw std::runtime_error(filePath + " isn't a multiple of the " + std::to_string(frameSize) + " bytes of output " + std::to_string(i));
+            }
+
+            size_t frameCount = data.size() / frameSize;
+            model.frameCount = model.frameCount == 0 ? frameCount : std::min(model.frameCount, frameCount);
+
+            model.recordedOutputs.resize(model.meta.outputs.size());
+            model.recordedOutputs[i] = std::move(data);
+        }
+    }
+
+    NbgMeta::Tensor toMetaTensor(const TensorRecording::Tensor &recorded)
+    {
+        NbgMeta::Tensor tensor;
+        tensor.sizes.assign(recorded.sizes, recorded.sizes + std::min(recorded.numOfDims, 6u));
+        tensor.dataFormat = recorded.dataFormat;
+        tensor.quantFormat = recorded.quantFormat;
+        tensor.fixedPointPos = recorded.fixedPointPos;
+        tensor.scale = recorded.scale;
+        tensor.zeroPoint = recorded.zeroPoint;
+        return tensor;
+    }
+
+    void loadReplay(Model &model)
+    {
+        model.replay = std::make_shared<TensorRecording::Reader>(settings.replayFilePath);
+
+        const TensorRecording::Header &header = model.replay->getHeader();
+
+        for (uint32_t i = 0; i < header.inputCount; i++)
+        {
+            model.meta.inputs.push_back(toMetaTensor(model.replay->getInput(i)));
+        }
+
+        for (uint32_t i = 0; i < header.outputCount; i++)
+        {
+            model.meta.outputs.push_back(toMetaTensor(model.replay->getOutput(i)));
+        }
+
+        model.frameCount = model.replay->getFrameCount();
+        if (model.frameCount == 0)
+        {
+            throw std::runtime_error(settings.replayFilePath + " has no frames");
+        }
+    }
+
+    vip_uint32_t getBufferSize(const vip_buffer_create_params_t &params)
+    {
+        vip_uint32_t size = NbgMeta::getElementSize(params.data_format);
+
+        for (vip_uint32_t i = 0; i < params.num_of_dims && i < 6; i++)
+        {
+            size *= params.sizes[i];
+        }
+
+        return size;
+    }
+
+    unsigned int drawLatencyUs(unsigned int baseLatencyUs)
+    {
+        long long latencyUs = baseLatencyUs;
+
+        if (settings.jitterUs > 0)
+        {
+            std::uniform_int_distribution<int> jitter(-(int)settings.jitterUs, (int)settings.jitterUs);
+            latencyUs += jitter(random);
+        }
+
+        latencyUs = std::max(0LL, latencyUs);
+
+        // a lower clock takes proportionally longer
+        return latencyUs * 100 / clockScalePercent;
+    }
+}
+
+struct _vip_buffer
+{
+    vip_buffer_create_params_t params;
+    void *memory = nullptr;
+    vip_uint32_t size = 0;
+    bool isOwned = false;
+    bool isMmapped = false;
+};
+
+struct _vip_network
+{
+    std::shared_ptr<Model> model;
+    std::string name;
+    std::vector<vip_buffer> inputs;
+    std::vector<vip_buffer> outputs;
+    bool isPrepared = false;
+    vip_uint32_t deviceId = 0;
+
+    bool isInFlight = false;
+    bool isCancelled = false;
+    bool isHung = false;
+    size_t frame = 0;
+    Clock::time_point finishTime;
+    vip_inference_profile_t profile = {0, 0};
+};
+
+struct _vip_group
+{
+    vip_uint32_t count = 0;
+    std::vector<vip_network> networks;
+};
+
+namespace
+{
+    // Called with stubMutex held.
+    vip_status_e triggerNetwork(vip_network network)
+    {
+        if (initCount == 0 || network == nullptr)
+        {
+            return VIP_ERROR_INVALID_ARGUMENTS;
+        }
+
+        if (!network->isPrepared)
+        {
+            return VIP_ERROR_NETWORK_NOT_PREPARED;
+        }
+
+        if (isPoweredOff)
+        {
+            return VIP_ERROR_POWER_OFF;
+        }
+
+        if (isStopped)
+        {
+            return VIP_ERROR_POWER_STOP;
+        }
+
+        for (auto buffer : network->inputs)
+        {
+            if (buffer == nullptr)
+            {
+                return VIP_ERROR_MISSING_INPUT_OUTPUT;
+            }
+        }
+
+        for (auto buffer : network->outputs)
+        {
+            if (buffer == nullptr)
+            {
+                return VIP_ERROR_MISSING_INPUT_OUTPUT;
+            }
+        }
+
+        Model &model = *network->model;
+        network->frame = model.frameCount > 0 ? model.nextFrame++ % model.frameCount : 0;
+
+        unsigned int baseLatencyUs = settings.latencyUs;
+        if (model.replay != nullptr && !settings.isLatencySet)
+        {
+            const TensorRecording::Frame &frame = model.replay->getFrame(network->frame);
+            baseLatencyUs = frame.npuTimeUs != 0 ? frame.npuTimeUs : frame.submitToCompleteUs;
+        }
+
+        unsigned int latencyUs = drawLatencyUs(baseLatencyUs);
+
+        Clock::time_point &busyUntil = deviceBusyUntil[network->deviceId < deviceBusyUntil.size() ? network->deviceId : 0];
+        // queued behind a hung job, it doesn't finish either
+        bool isDeviceHung = busyUntil == Clock::time_point::max();
+        Clock::time_point startTime = isDeviceHung ? Clock::now() : std::max(Clock::now(), busyUntil);
+
+        network->finishTime = startTime + std::chrono::microseconds(latencyUs);
+        network->isHung = (settings.hangEvery > 0 && ++inferenceCount % settings.hangEvery == 0) || isDeviceHung;
+        network->isCancelled = false;
+        network->isInFlight = true;
+        network->profile.inference_time = latencyUs;
+        network->profile.total_cycle = latencyUs * CYCLES_PER_US * clockScalePercent / 100;
+
+        // a hung job holds the device until it is cancelled
+        busyUntil = network->isHung ? Clock::time_point::max() : network->finishTime;
+
+        return VIP_SUCCESS;
+    }
+
+    // Called with stubMutex held.
+    void writeOutputs(vip_network network)
+    {
+        Model &model = *network->model;
+
+        size_t frame = network->frame;
+
+        for (size_t i = 0; i < network->outputs.size(); i++)
+        {
+            vip_buffer output = network->outputs[i];
+            vip_uint32_t frameSize = NbgMeta::getTensorSize(model.meta.outputs[i]);
+
+            if (model.replay != nullptr)
+            {
+                memcpy(output->memory, model.replay->getOutputData(frame, i), frameSize);
+            }
+            else if (i < model.recordedOutputs.size() && !model.recordedOutputs[i].empty())
+            {
+                memcpy(output->memory, model.recordedOutputs[i].data() + frame * frameSize, frameSize);
+            }
+            else
+            {
+                memset(output->memory, 0, frameSize);
+            }
+        }
+    }
+
+    vip_status_e waitNetwork(std::unique_lock<std::mutex> &lock, vip_network network)
+    {
+        if (network == nullptr)
+        {
+            return VIP_ERROR_INVALID_ARGUMENTS;
+        }
+
+        auto isCancelled = [network]() { return network->isCancelled; };
+
+        if (network->isInFlight)
+        {
+            if (network->isHung)
+            {
+                finishedCondVar.wait(lock, isCancelled);
+            }
+            else
+            {
+                finishedCondVar.wait_until(lock, network->finishTime, isCancelled);
+            }
+        }
+
+        if (!network->isInFlight)
+        {
+            return VIP_SUCCESS;
+        }
+
+        network->isInFlight = false;
+
+        if (network->isCancelled)
+        {
+            network->isCancelled = false;
+            return VIP_ERROR_CANCELED;
+        }
+
+        writeOutputs(network);
+
+        return VIP_SUCCESS;
+    }
+
+    vip_status_e queryTensor(const std::vector<NbgMeta::Tensor> &tensors, vip_uint32_t index, vip_enum property, void *value)
+    {
+        if (index >= tensors.size() || value == nullptr)
+        {
+            return VIP_ERROR_INVALID_ARGUMENTS;
+        }
+
+        const NbgMeta::Tensor &tensor = tensors[index];
+
+        switch (property)
+        {
+        case VIP_BUFFER_PROP_QUANT_FORMAT:
+            *(vip_enum *)value = tensor.quantFormat;
+            break;
+        case VIP_BUFFER_PROP_NUM_OF_DIMENSION:
+            *(vip_uint32_t *)value = tensor.sizes.size();
+            break;
+        case VIP_BUFFER_PROP_SIZES_OF_DIMENSION:
+            std::copy(tensor.sizes.begin(), tensor.sizes.end(), (vip_uint32_t *)value);
+            break;
+        case VIP_BUFFER_PROP_DATA_FORMAT:
+            *(vip_enum *)value = tensor.dataFormat;
+            break;
+        case VIP_BUFFER_PROP_FIXED_POINT_POS:
+            *(vip_int32_t *)value = tensor.fixedPointPos;
+            break;
+        case VIP_BUFFER_PROP_TF_SCALE:
+            *(vip_float_t *)value = tensor.scale;
+            break;
+        case VIP_BUFFER_PROP_TF_ZERO_POINT:
+            *(vip_int32_t *)value = tensor.zeroPoint;
+            break;
+        case VIP_BUFFER_PROP_NAME:
+            strncpy((char *)value, tensor.name.c_str(), NAME_SIZE - 1);
+            ((char *)value)[NAME_SIZE - 1] = '\0';
+            break;
+        default:
+            return VIP_ERROR_NOT_SUPPORTED;
+        }
+
+        return VIP_SUCCESS;
+    }
+
+    vip_status_e attachBuffer(std::vector<vip_buffer> &attached, const std::vector<NbgMeta::Tensor> &tensors, vip_uint32_t index, vip_buffer buffer)
+    {
+        if (index >= attached.size() || buffer == nullptr || buffer->size < NbgMeta::getTensorSize(tensors[index]))
+        {
+            return VIP_ERROR_INVALID_ARGUMENTS;
+        }
+
+        std::lock_guard<std::mutex> lock(stubMutex);
+        attached[index] = buffer;
+
+        return VIP_SUCCESS;
+    }
+}
+
+extern "C" {
+
+vip_uint32_t vip_get_version(void)
+{
+    return VERSION;
+}
+
+vip_status_e vip_init(vip_uint32_t video_mem_size)
+{
+    std::lock_guard<std::mutex> lock(stubMutex);
+
+    if (initCount++ == 0)
+    {
+        settings = loadSettings();
+        deviceBusyUntil.assign(settings.deviceCount, Clock::time_point());
+        isPoweredOff = false;
+        isStopped = false;
+        clockScalePercent = 100;
+        inferenceCount = 0;
+
+        std::cout << "VIPLite stub: " << video_mem_size << " bytes, " << settings.deviceCount << " devices, "
+                  << settings.latencyUs << " +/- " << settings.jitterUs << " us per inference" << std::endl;
+    }
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_destroy(void)
+{
+    std::lock_guard<std::mutex> lock(stubMutex);
+
+    if (initCount == 0)
+    {
+        return VIP_ERROR_FAILURE;
+    }
+
+    initCount--;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_query_hardware(vip_query_hardware_property_e property, vip_uint32_t size, void *value)
+{
+    std::lock_guard<std::mutex> lock(stubMutex);
+
+    if (value == nullptr || size < sizeof(vip_uint32_t))
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    switch (property)
+    {
+    case VIP_QUERY_HW_PROP_CID:
+        *(vip_uint32_t *)value = CID;
+        break;
+    case VIP_QUERY_HW_PROP_DEVICE_COUNT:
+        *(vip_uint32_t *)value = settings.deviceCount;
+        break;
+    case VIP_QUERY_HW_PROP_CORE_COUNT_EACH_DEVICE:
+        for (vip_uint32_t i = 0; i < size / sizeof(vip_uint32_t) && i < settings.deviceCount; i++)
+        {
+            ((vip_uint32_t *)value)[i] = 1;
+        }
+        break;
+    default:
+        return VIP_ERROR_NOT_SUPPORTED;
+    }
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_create_buffer(vip_buffer_create_params_t *create_param, vip_uint32_t size_of_param, vip_buffer *buffer)
+{
+    if (create_param == nullptr || buffer == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    vip_uint32_t size = getBufferSize(*create_param);
+
+    void *memory = nullptr;
+    if (posix_memalign(&memory, 64, std::max(size, 64u)) != 0)
+    {
+        return VIP_ERROR_OUT_OF_MEMORY;
+    }
+    memset(memory, 0, size);
+
+    vip_buffer created = new _vip_buffer();
+    created->params = *create_param;
+    created->memory = memory;
+    created->size = size;
+    created->isOwned = true;
+
+    *buffer = created;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_create_buffer_from_physical(const vip_buffer_create_params_t *create_param, const vip_address_t *physical_table,
+                                             const vip_uint32_t *size_table, vip_uint32_t physical_num, vip_buffer *buffer)
+{
+    // there is no physical memory to reach from a host process
+    return VIP_ERROR_NOT_SUPPORTED;
+}
+
+vip_status_e vip_create_buffer_from_handle(const vip_buffer_create_params_t *create_param, const vip_ptr handle_logical,
+                                           vip_uint32_t handle_size, vip_buffer *buffer)
+{
+    if (create_param == nullptr || handle_logical == nullptr || buffer == nullptr || handle_size < getBufferSize(*create_param))
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    vip_buffer created = new _vip_buffer();
+    created->params = *create_param;
+    created->memory = handle_logical;
+    created->size = handle_size;
+
+    *buffer = created;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_create_buffer_from_fd(const vip_buffer_create_params_t *create_param, vip_uint32_t fd, vip_uint32_t memory_size,
+                                       vip_buffer *buffer)
+{
+    if (create_param == nullptr || buffer == nullptr || memory_size < getBufferSize(*create_param))
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    void *memory = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+    {
+        return VIP_ERROR_IO;
+    }
+
+    vip_buffer created = new _vip_buffer();
+    created->params = *create_param;
+    created->memory = memory;
+    created->size = memory_size;
+    created->isMmapped = true;
+
+    *buffer = created;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_destroy_buffer(vip_buffer buffer)
+{
+    if (buffer == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    if (buffer->isOwned)
+    {
+        free(buffer->memory);
+    }
+    else if (buffer->isMmapped)
+    {
+        munmap(buffer->memory, buffer->size);
+    }
+
+    delete buffer;
+
+    return VIP_SUCCESS;
+}
+
+void *vip_map_buffer(vip_buffer buffer)
+{
+    return buffer != nullptr ? buffer->memory : nullptr;
+}
+
+vip_status_e vip_unmap_buffer(vip_buffer buffer)
+{
+    return buffer != nullptr ? VIP_SUCCESS : VIP_ERROR_INVALID_ARGUMENTS;
+}
+
+vip_uint32_t vip_get_buffer_size(vip_buffer buffer)
+{
+    return buffer != nullptr ? buffer->size : 0;
+}
+
+vip_status_e vip_flush_buffer(vip_buffer buffer, vip_buffer_operation_type_e type)
+{
+    // host memory is coherent
+    return buffer != nullptr ? VIP_SUCCESS : VIP_ERROR_INVALID_ARGUMENTS;
+}
+
+vip_status_e vip_create_network(const void *data, vip_uint32_t size_of_data, vip_enum type, vip_network *network)
+{
+    if (data == nullptr || network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    std::string modelFilePath;
+
+    if (type & VIP_CREATE_NETWORK_FROM_FILE)
+    {
+        modelFilePath = (const char *)data;
+
+        if (!isReadable(modelFilePath))
+        {
+            std::cerr << "VIPLite stub: can't open " << modelFilePath << std::endl;
+            return VIP_ERROR_IO;
+        }
+    }
+    else if (!(type & VIP_CREATE_NETWORK_FROM_MEMORY))
+    {
+        return VIP_ERROR_NOT_SUPPORTED;
+    }
+
+    std::shared_ptr<Model> model = std::make_shared<Model>();
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(stubMutex);
+
+        if (!settings.replayFilePath.empty())
+        {
+            loadReplay(*model);
+        }
+        else
+        {
+            std::string metaFilePath = findMetaFile(modelFilePath);
+            if (metaFilePath.empty())
+            {
+                std::cerr << "VIPLite stub: set VIP_STUB_META for a network created from memory" << std::endl;
+                return VIP_ERROR_INVALID_NETWORK;
+            }
+
+            model->meta = NbgMeta::load(metaFilePath);
+            loadRecordedOutputs(*model);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "VIPLite stub: " << e.what() << std::endl;
+        return VIP_ERROR_INVALID_NETWORK;
+    }
+
+    vip_network created = new _vip_network();
+    created->model = model;
+    created->inputs.resize(model->meta.inputs.size(), nullptr);
+    created->outputs.resize(model->meta.outputs.size(), nullptr);
+
+    size_t slash = modelFilePath.rfind('/');
+    created->name = modelFilePath.empty() ? "network" : modelFilePath.substr(slash == std::string::npos ? 0 : slash + 1);
+
+    *network = created;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_destroy_network(vip_network network)
+{
+    if (network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    delete network;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_set_network(vip_network network, vip_enum property, void *value)
+{
+    if (network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    std::lock_guard<std::mutex> lock(stubMutex);
+
+    if (network->isPrepared && property != VIP_NETWORK_PROP_CHANGE_PPU_PARAM)
+    {
+        return VIP_ERROR_FAILURE;
+    }
+
+    switch (property)
+    {
+    case VIP_NETWORK_PROP_SET_DEVICE_ID:
+        if (value == nullptr || *(vip_uint32_t *)value >= settings.deviceCount)
+        {
+            return VIP_ERROR_INVALID_ARGUMENTS;
+        }
+        network->deviceId = *(vip_uint32_t *)value;
+        break;
+    case VIP_NETWORK_PROP_SET_PRIORITY:
+    case VIP_NETWORK_PROP_SET_MEMORY_POOL:
+    case VIP_NETWORK_PROP_CHANGE_PPU_PARAM:
+        // jobs of one device run in trigger order
+        break;
+    default:
+        return VIP_ERROR_NOT_SUPPORTED;
+    }
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_query_network(vip_network network, vip_enum property, void *value)
+{
+    if (network == nullptr || value == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    std::lock_guard<std::mutex> lock(stubMutex);
+
+    switch (property)
+    {
+    case VIP_NETWORK_PROP_LAYER_COUNT:
+        *(vip_uint32_t *)value = 1;
+        break;
+    case VIP_NETWORK_PROP_INPUT_COUNT:
+        *(vip_uint32_t *)value = network->inputs.size();
+        break;
+    case VIP_NETWORK_PROP_OUTPUT_COUNT:
+        *(vip_uint32_t *)value = network->outputs.size();
+        break;
+    case VIP_NETWORK_PROP_NETWORK_NAME:
+        strncpy((char *)value, network->name.c_str(), NAME_SIZE - 1);
+        ((char *)value)[NAME_SIZE - 1] = '\0';
+        break;
+    case VIP_NETWORK_PROP_MEMORY_POOL_SIZE:
+        *(vip_uint32_t *)value = settings.memoryPoolSize;
+        break;
+    case VIP_NETWORK_PROP_PROFILING:
+        *(vip_inference_profile_t *)value = network->profile;
+        break;
+    default:
+        return VIP_ERROR_NOT_SUPPORTED;
+    }
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_prepare_network(vip_network network)
+{
+    if (network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    std::lock_guard<std::mutex> lock(stubMutex);
+    network->isPrepared = true;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_query_input(vip_network network, vip_uint32_t index, vip_enum property, void *value)
+{
+    if (network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    return queryTensor(network->model->meta.inputs, index, property, value);
+}
+
+vip_status_e vip_query_output(vip_network network, vip_uint32_t index, vip_enum property, void *value)
+{
+    if (network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    return queryTensor(network->model->meta.outputs, index, property, value);
+}
+
+vip_status_e vip_set_input(vip_network network, vip_uint32_t index, vip_buffer input)
+{
+    if (network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    return attachBuffer(network->inputs, network->model->meta.inputs, index, input);
+}
+
+vip_status_e vip_set_output(vip_network network, vip_uint32_t index, vip_buffer output)
+{
+    if (network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    return attachBuffer(network->outputs, network->model->meta.outputs, index, output);
+}
+
+vip_status_e vip_run_network(vip_network network)
+{
+    std::unique_lock<std::mutex> lock(stubMutex);
+
+    vip_status_e status = triggerNetwork(network);
+    if (status != VIP_SUCCESS)
+    {
+        return status;
+    }
+
+    return waitNetwork(lock, network);
+}
+
+vip_status_e vip_finish_network(vip_network network)
+{
+    if (network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    std::lock_guard<std::mutex> lock(stubMutex);
+    network->isPrepared = false;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_trigger_network(vip_network network)
+{
+    std::lock_guard<std::mutex> lock(stubMutex);
+
+    return triggerNetwork(network);
+}
+
+vip_status_e vip_trigger_group(vip_group group, vip_uint32_t num)
+{
+    if (group == nullptr || num > group->networks.size())
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    std::lock_guard<std::mutex> lock(stubMutex);
+
+    // back to back on their devices, in add order
+    for (vip_uint32_t i = 0; i < num; i++)
+    {
+        vip_status_e status = triggerNetwork(group->networks[i]);
+        if (status != VIP_SUCCESS)
+        {
+            return status;
+        }
+    }
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_wait_network(vip_network network)
+{
+    std::unique_lock<std::mutex> lock(stubMutex);
+
+    return waitNetwork(lock, network);
+}
+
+vip_status_e vip_wait_group(vip_group group)
+{
+    if (group == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    std::unique_lock<std::mutex> lock(stubMutex);
+
+    vip_status_e groupStatus = VIP_SUCCESS;
+
+    for (vip_network network : group->networks)
+    {
+        vip_status_e status = waitNetwork(lock, network);
+        if (groupStatus == VIP_SUCCESS)
+        {
+            groupStatus = status;
+        }
+    }
+
+    return groupStatus;
+}
+
+vip_status_e vip_cancel_network(vip_network network)
+{
+    if (network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    std::lock_guard<std::mutex> lock(stubMutex);
+
+    if (network->isInFlight)
+    {
+        network->isCancelled = true;
+
+        Clock::time_point &busyUntil = deviceBusyUntil[network->deviceId < deviceBusyUntil.size() ? network->deviceId : 0];
+        if (network->isHung)
+        {
+            busyUntil = Clock::now();
+        }
+
+        finishedCondVar.notify_all();
+    }
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_power_management(vip_network network, vip_enum property, void *value)
+{
+    std::unique_lock<std::mutex> lock(stubMutex);
+
+    switch (property)
+    {
+    case VIP_POWER_PROPERTY_SET_FREQUENCY:
+    {
+        if (value == nullptr)
+        {
+            return VIP_ERROR_INVALID_ARGUMENTS;
+        }
+
+        unsigned int percent = ((vip_power_frequency_t *)value)->fscale_percent;
+        clockScalePercent = std::min(100u, std::max(1u, percent));
+        break;
+    }
+    case VIP_POWER_PROPERTY_OFF:
+        isPoweredOff = true;
+        break;
+    case VIP_POWER_PROPERTY_ON:
+        if (isPoweredOff && settings.resumeUs > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(settings.resumeUs));
+        }
+        isPoweredOff = false;
+        break;
+    case VIP_POWER_PROPERTY_STOP:
+        isStopped = true;
+        break;
+    case VIP_POWER_PROPERTY_START:
+        isStopped = false;
+        break;
+    default:
+        return VIP_ERROR_NOT_SUPPORTED;
+    }
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_create_group(vip_uint32_t count, vip_group *group)
+{
+    if (count == 0 || group == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    vip_group created = new _vip_group();
+    created->count = count;
+    created->networks.reserve(count);
+
+    *group = created;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_destroy_group(vip_group group)
+{
+    if (group == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    delete group;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_add_network(vip_group group, vip_network network)
+{
+    if (group == nullptr || network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    if (group->networks.size() >= group->count)
+    {
+        return VIP_ERROR_OUT_OF_RESOURCE;
+    }
+
+    group->networks.push_back(network);
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_weak_dup_network(vip_network network, vip_network *dup_network)
+{
+    if (network == nullptr || dup_network == nullptr)
+    {
+        return VIP_ERROR_INVALID_ARGUMENTS;
+    }
+
+    std::lock_guard<std::mutex> lock(stubMutex);
+
+    vip_network dup = new _vip_network();
+    dup->model = network->model;
+    dup->name = network->name;
+    dup->inputs = network->inputs;
+    dup->outputs = network->outputs;
+    dup->deviceId = network->deviceId;
+
+    *dup_network = dup;
+
+    return VIP_SUCCESS;
+}
+
+vip_status_e vip_run_group(vip_group group, vip_uint32_t num)
+{
+    vip_status_e status = vip_trigger_group(group, num);
+    if (status != VIP_SUCCESS)
+    {
+        return status;
+    }
+
+    return vip_wait_group(group);
+}
+
+vip_status_e vip_set_ppu_param(vip_network network, vip_ppu_param_t *param, vip_uint32_t index)
+{
+    return network != nullptr && param != nullptr ? VIP_SUCCESS : VIP_ERROR_INVALID_ARGUMENTS;
+}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vip_lite.h"
+
+// Inputs and outputs of a network binary as described by the nbg_meta.json the converter writes next to it.
+class NbgMeta
+{
+public:
+    struct Tensor
+    {
+        std::string name;
+        // innermost dimension first, like vip_buffer_create_params_t::sizes
+        std::vector<vip_uint32_t> sizes;
+        vip_enum dataFormat = VIP_BUFFER_FORMAT_FP32;
+        vip_enum quantFormat = VIP_BUFFER_QUANTIZE_NONE;
+        vip_int32_t fixedPointPos = 0;
+        vip_float_t scale = 1.0f;
+        vip_int32_t zeroPoint = 0;
+    };
+
+    std::vector<Tensor> inputs;
+    std::vector<Tensor> outputs;
+
+    // Throws std::runtime_error if the file can't be read or isn't a nbg_meta.json.
+    static NbgMeta load(const std::string &filePath);
+
+    static vip_uint32_t getElementSize(vip_enum dataFormat);
+
+    static vip_uint32_t getTensorSize(const Tensor &tensor);
+};